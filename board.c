@@ -0,0 +1,253 @@
+/* board.c -- every hole-card combination ranked on one board
+
+Example:
+
+  BoardRanking *bp = malloc(sizeof(BoardRanking));
+  rank_board(board, dead, bp);     // board: five cards as a mask
+
+  bp->n                  // combos clear of the board and dead cards
+  bp->combos[i]          // sorted weakest first ...
+  bp->keys[i]            // ... with their strength keys,
+  bp->ranks[i]           // their dense rank (0 for the weakest),
+  bp->group_start[r]     // and where rank r's tie group begins
+
+The board is split into per-suit rank masks once, and each combo's two
+cards are just ORed in before evaluating, rather than making 1326
+Hands. rank_boards does a whole list of boards on several threads.
+
+Once a board is ranked, range_equity gets range-against-range equity
+in one sweep up the sorted combos, instead of comparing every pair:
+it keeps running totals of the second range's weight below the
+current tie group, overall and per card, and takes off the combos
+that share a card (see below). board_strengths does the same for
+every combo at once against a uniform opponent.
+
+Combos are numbered 0 to 1325 by combo_index, for a < b:
+
+  b * (b - 1) / 2 + a
+
+*/
+
+#include "cards.h"
+#include <pthread.h>
+#include <string.h>
+
+#define DECK ((CARD_BIT(52)) - 1)
+
+typedef struct {
+    int key;
+    CardMask combo;
+} ranked_combo;
+
+int combo_index(CardMask combo)
+{
+    int a = __builtin_ctzll(combo);
+    int b = 63 - __builtin_clzll(combo);
+    return b * (b - 1) / 2 + a;
+}
+
+CardMask index_combo(int i)
+{
+    int b = 1;
+    while ((b + 1) * b / 2 <= i) {
+	b++;
+    }
+    return CARD_BIT(b) | CARD_BIT(i - b * (b - 1) / 2);
+}
+
+/* A three-pass radix sort on the 24-bit keys. It's stable, and the
+   combos are made in increasing order, so ties stay in combo order. */
+
+static ranked_combo *sort_by_key(ranked_combo *in, ranked_combo *spare, int n)
+{
+    int counts[256], shift, i, sum, digit;
+    ranked_combo *swap;
+
+    for (shift = 0; shift < 24; shift += 8) {
+	memset(counts, 0, sizeof(counts));
+	for (i = 0; i < n; i++) {
+	    counts[(in[i].key >> shift) & 0xff]++;
+	}
+	for (i = 0, sum = 0; i < 256; i++) {
+	    digit = counts[i];
+	    counts[i] = sum;
+	    sum += digit;
+	}
+	for (i = 0; i < n; i++) {
+	    spare[counts[(in[i].key >> shift) & 0xff]++] = in[i];
+	}
+	swap = in;
+	in = spare;
+	spare = swap;
+    }
+    return in;
+}
+
+int rank_board(CardMask board, CardMask dead, BoardRanking *bp)
+{
+    ranked_combo made[COMBOS_N], spare[COMBOS_N], *sorted;
+    unsigned suit[4], with[4];
+    CardMask live = DECK & ~board & ~dead;
+    int a, b, i, n = 0;
+
+    for (i = 0; i < 4; i++) {
+	suit[i] = (board >> (13 * i)) & 0x1fff;
+    }
+    for (b = 1; b < 52; b++) {
+	if (!(live & CARD_BIT(b))) {
+	    continue;
+	}
+	for (a = 0; a < b; a++) {
+	    if (!(live & CARD_BIT(a))) {
+		continue;
+	    }
+	    memcpy(with, suit, sizeof(suit));
+	    with[a / 13] |= 1u << (a % 13);
+	    with[b / 13] |= 1u << (b % 13);
+	    made[n].key = suit_masks_strength(with[0], with[1], with[2], with[3]);
+	    made[n++].combo = CARD_BIT(a) | CARD_BIT(b);
+	}
+    }
+    sorted = sort_by_key(made, spare, n);
+
+    bp->board = board;
+    bp->n = n;
+    bp->groups = 0;
+    for (i = 0; i < n; i++) {
+	if (i == 0 || sorted[i].key != sorted[i - 1].key) {
+	    bp->group_start[bp->groups++] = i;
+	}
+	bp->combos[i] = sorted[i].combo;
+	bp->keys[i] = sorted[i].key;
+	bp->ranks[i] = bp->groups - 1;
+    }
+    bp->group_start[bp->groups] = n;
+    return n;
+}
+
+typedef struct {
+    CardMask *boards;
+    CardMask dead;
+    BoardRanking *out;
+    int n, first, step;
+} board_job;
+
+static void *rank_some_boards(void *arg)
+{
+    board_job *jp = arg;
+    int i;
+    for (i = jp->first; i < jp->n; i += jp->step) {
+	rank_board(jp->boards[i], jp->dead, &jp->out[i]);
+    }
+    return NULL;
+}
+
+/* Ranks n boards into out[0..n-1], spread over the given number of
+   threads. */
+
+void rank_boards(CardMask *boards, int n, CardMask dead, BoardRanking *out, int threads)
+{
+    pthread_t ids[threads];
+    board_job jobs[threads];
+    int i;
+
+    for (i = 0; i < threads; i++) {
+	jobs[i] = (board_job){ boards, dead, out, n, i, threads };
+	pthread_create(&ids[i], NULL, rank_some_boards, &jobs[i]);
+    }
+    for (i = 0; i < threads; i++) {
+	pthread_join(ids[i], NULL);
+    }
+}
+
+/* The equity of range1 against range2 on a ranked board. Ranges are
+   weights indexed by combo_index; combos on the board or dead don't
+   count. For a combo {a, b} of range1 the opponent combos it can meet
+   are all of them less those holding a or b, which, by inclusion and
+   exclusion, is
+
+     total - with[a] - with[b] + weight{a, b}
+
+   and the same goes for the ones below its tie group and the ones in
+   it. */
+
+double range_equity(BoardRanking *bp, double *range1, double *range2)
+{
+    double total = 0, below = 0, tied, w1, w2;
+    double with[52] = { 0 }, with_below[52] = { 0 }, with_tied[52];
+    double won = 0, met = 0, beaten, even, all;
+    int g, i, a, b, index;
+
+    for (i = 0; i < bp->n; i++) {
+	w2 = range2[combo_index(bp->combos[i])];
+	total += w2;
+	with[__builtin_ctzll(bp->combos[i])] += w2;
+	with[63 - __builtin_clzll(bp->combos[i])] += w2;
+    }
+
+    for (g = 0; g < bp->groups; g++) {
+	tied = 0;
+	memset(with_tied, 0, sizeof(with_tied));
+	for (i = bp->group_start[g]; i < bp->group_start[g + 1]; i++) {
+	    w2 = range2[combo_index(bp->combos[i])];
+	    tied += w2;
+	    with_tied[__builtin_ctzll(bp->combos[i])] += w2;
+	    with_tied[63 - __builtin_clzll(bp->combos[i])] += w2;
+	}
+	for (i = bp->group_start[g]; i < bp->group_start[g + 1]; i++) {
+	    index = combo_index(bp->combos[i]);
+	    if (!(w1 = range1[index])) {
+		continue;
+	    }
+	    a = __builtin_ctzll(bp->combos[i]);
+	    b = 63 - __builtin_clzll(bp->combos[i]);
+	    w2 = range2[index];
+	    beaten = below - with_below[a] - with_below[b];
+	    even = tied - with_tied[a] - with_tied[b] + w2;
+	    all = total - with[a] - with[b] + w2;
+	    won += w1 * (beaten + even / 2);
+	    met += w1 * all;
+	}
+	below += tied;
+	for (a = 0; a < 52; a++) {
+	    with_below[a] += with_tied[a];
+	}
+    }
+    return met ? won / met : 0;
+}
+
+/* Every combo's hand strength on a ranked board: the share of the
+   other combos it beats, with ties as half, against an opponent who's
+   as likely to hold any of them. strength[] is indexed by combo_index
+   like the ranges above; combos that aren't live are left alone. */
+
+void board_strengths(BoardRanking *bp, double *strength)
+{
+    int with[52] = { 0 }, with_below[52] = { 0 }, with_tied[52];
+    int below = 0, tied, beaten, even, all, g, i, a, b;
+
+    for (i = 0; i < bp->n; i++) {
+	with[__builtin_ctzll(bp->combos[i])]++;
+	with[63 - __builtin_clzll(bp->combos[i])]++;
+    }
+    for (g = 0; g < bp->groups; g++) {
+	tied = bp->group_start[g + 1] - bp->group_start[g];
+	memset(with_tied, 0, sizeof(with_tied));
+	for (i = bp->group_start[g]; i < bp->group_start[g + 1]; i++) {
+	    with_tied[__builtin_ctzll(bp->combos[i])]++;
+	    with_tied[63 - __builtin_clzll(bp->combos[i])]++;
+	}
+	for (i = bp->group_start[g]; i < bp->group_start[g + 1]; i++) {
+	    a = __builtin_ctzll(bp->combos[i]);
+	    b = 63 - __builtin_clzll(bp->combos[i]);
+	    beaten = below - with_below[a] - with_below[b];
+	    even = tied - with_tied[a] - with_tied[b] + 1;
+	    all = bp->n - with[a] - with[b] + 1;
+	    strength[combo_index(bp->combos[i])] = all ? (beaten + even / 2.0) / all : 0;
+	}
+	below += tied;
+	for (a = 0; a < 52; a++) {
+	    with_below[a] += with_tied[a];
+	}
+    }
+}
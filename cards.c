@@ -110,3 +110,25 @@ int index_of_rank(char *rank)
     return -1;
 }
 
+
+int index_of_suit(char *suit)
+{
+    int i;
+    for (i = 0; i < 4; i++) {
+	if (!strcmp(suit, suits[i])) {
+	    return i;
+	}
+    }
+    return -1;
+}
+
+/* The card's position in a CardMask (see mask.c), or -1 for a card
+   with an unknown rank or suit.
+*/
+
+int card_index(Card *cp)
+{
+    int rank = index_of_rank(cp->rank);
+    int suit = index_of_suit(cp->suit);
+    return (rank < 0 || suit < 0) ? -1 : suit * 13 + rank;
+}
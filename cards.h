@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 
 #define RANK_N 13;
 
@@ -25,6 +26,184 @@ typedef struct {
     int(*chooser_function)(Hand *, Hand *);
 } ranking_datum;
 
+typedef uint64_t CardMask;
+
+#define CARD_BIT(i) ((CardMask)1 << (i))
+#define RANKINGS_N 9
+/* A key's ranking_data index. Only wild_strength's keys can give
+   FIVE_OF_A_KIND, which is outside ranking_data and every RANKINGS_N
+   table, so check for it before indexing with one of those. */
+#define STRENGTH_RANKING(key) (8 - ((key) >> 20))
+#define FIVE_OF_A_KIND (-1)
+
+typedef struct {
+    int ranking;
+    int to_come;
+    int runouts;
+    int outs[RANKINGS_N];
+    int clean[RANKINGS_N];
+    double probability[RANKINGS_N];
+    double clean_probability[RANKINGS_N];
+    CardMask cards[RANKINGS_N];
+} Outs;
+
+typedef struct {
+    long wins;
+    long ties;
+    long losses;
+} Equity;
+
+#define COMBOS_N 1326
+
+typedef struct {
+    CardMask board;
+    int n;
+    int groups;
+    CardMask combos[COMBOS_N];
+    int keys[COMBOS_N];
+    int ranks[COMBOS_N];
+    int group_start[COMBOS_N + 1];
+} BoardRanking;
+
+typedef struct ring Ring;
+
+#define HANDS_MAGIC "CCHB"
+#define HANDS_VERSION 1
+#define HANDS_BLOCK 4096
+#define HANDS_UNKNOWN UINT64_MAX
+#define HANDS_PACKED 1
+#define HANDS_STRENGTH 2
+
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint8_t hand_size;
+    uint8_t flags;
+    uint32_t block_hands;
+    uint32_t reserved;
+    uint64_t count;
+} HandFileHeader;
+
+typedef struct {
+    uint32_t hands;
+    uint32_t marker;
+} HandBlockHeader;
+
+#define MC_MAGIC "CCMC"
+#define MC_VERSION 1
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint64_t key;
+    uint64_t first;
+    uint64_t count;
+    uint64_t wins;
+    uint64_t ties;
+    uint64_t losses;
+    uint64_t sum;
+    uint64_t sum_squares;
+    CardMask hole1;
+    CardMask hole2;
+    CardMask board;
+} McResult;
+
+#define STRENGTH_MAGIC "CCHS"
+#define STRENGTH_VERSION 1
+#define STRENGTH_FLOP 1
+#define STRENGTH_TURN 2
+#define STRENGTH_RIVER 4
+
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint8_t streets;
+    uint8_t complete;
+    uint32_t boards[3];
+    uint32_t reserved;
+    uint64_t offset[3];
+} StrengthFileHeader;
+
+#define SEATS_MAX 10
+#define STARTING_HANDS 169
+#define SHARE_UNIT 2520
+
+typedef struct {
+    int seats;
+    uint64_t key;
+    uint64_t first;
+    uint64_t hands;
+    uint64_t dealt[STARTING_HANDS];
+    uint64_t wins[STARTING_HANDS];
+    uint64_t ties[STARTING_HANDS];
+    uint64_t shares[STARTING_HANDS];
+} TableStats;
+
+typedef struct {
+    long draws;
+    long counts[RANKINGS_N];
+} DrawOutcome;
+
+/* Five-card hands that are different up to suits */
+#define CANONICAL_FIVES 134459
+
+typedef struct {
+    int n;
+    CardMask *hands;
+    CardMask *holds;
+    double *values;
+} DrawTable;
+
+#define SAMPLE_PLAIN 0
+#define SAMPLE_STRATIFIED 1
+#define SAMPLE_ANTITHETIC 2
+#define SAMPLE_QUASI 3
+#define SAMPLE_MODES 4
+
+typedef struct {
+    double equity;
+    double error;
+    double low;
+    double high;
+    long evaluations;
+} Estimate;
+
+typedef struct {
+    long hands;
+    long rejected;
+    long leads[2];            /* hands with one seat ahead on the flop, turn */
+    long held[2];             /* and that seat won or split */
+    long shown[RANKINGS_N];
+    long won[RANKINGS_N];
+    long dealt[STARTING_HANDS];
+    long wins[STARTING_HANDS];
+    long ties[STARTING_HANDS];
+    long shares[STARTING_HANDS];
+} HistoryStats;
+
+#define INLINE_CARDS 7
+
+typedef struct {
+    CardMask mask;
+    unsigned char len;
+    unsigned char cards[INLINE_CARDS];    /* card indices, in order */
+    unsigned char rank_counts[13];
+    unsigned char suit_counts[4];
+} __attribute__((aligned(64))) InlineHand;
+
+#define LOOKUP_CLASSES 7462
+
+typedef struct {
+    int n;
+    int keys[LOOKUP_CLASSES];     /* each class's strength key, ascending */
+    uint16_t *classes;            /* each 7-card set's class, by colex index */
+    size_t bytes;
+} LookupTable;
+
+typedef struct hand_writer HandWriter;
+typedef struct hand_reader HandReader;
+typedef struct strength_table StrengthTable;
+
 typedef int (*ranking_function)(Hand *);
 typedef int (*chooser_function)(Hand *, Hand *);
 
@@ -42,6 +221,18 @@ int two_pair_chooser(Hand *, Hand *);
 int pair_chooser(Hand *, Hand *);
 int high_card_chooser(Hand *, Hand *);
 int *rank_hand(Hand *);
+int hand_ranking(Hand *hand);
+int ordinal_ranking(char *desc);
+int compare_hands(Hand *hand1, Hand *hand2);
+int hand_beats_hand(Hand *hand1, Hand *hand2);
+int hand_tie(Hand *hand1, Hand *hand2);
+void add_card_to_hand(Hand *hand, char *rank, char *suit);
+void make_rankings_histogram(Hand *hand, int buckets[]);
+void n_of_a_kind_hash(Hand *hand, Mult *mp, int n);
+void hand_profile(Hand *hand);
+int eval_profile(Hand *hand, char *profile);
+int all_cards_consecutive(Card **cards);
+int is_a_baby_straight(Card **cards);
 Card *high_card(Hand *hand);
 char *hand_ranking_description(Hand *hand);
 Hand *create_batch_hand(char *info);
@@ -74,3 +265,91 @@ int hand_n_of_a_kinds(Hand *hand, int n);
 int rank_of_multiples(int[], int);
 int highest_unmatched_card(Hand *, int[]);
 int two_pair_hash(Hand *);
+int index_of_suit(char *suit);
+int card_index(Card *cp);
+CardMask hand_mask(Hand *hand);
+Hand *mask_to_hand(CardMask m);
+int straight_high(unsigned ranks);
+int suit_masks_strength(unsigned c, unsigned d, unsigned h, unsigned s);
+int mask_strength(CardMask m);
+int wild_strength(CardMask m, int wilds, unsigned wild_ranks);
+int mask_ranking(CardMask m);
+char *strength_description(int key);
+int mask_category(CardMask m);
+void mask_category_counts(CardMask *masks, long n, long counts[RANKINGS_N]);
+size_t mask_table_bytes(void);
+void mask_strengths(CardMask *masks, int *keys, int n);
+int text_to_mask(char *text, CardMask *mp, char **end);
+char *mask_to_text(char *buffer, CardMask m);
+int count_outs(CardMask hole, CardMask board, CardMask opponent, int to_come, Outs *op);
+void reference_value(Hand *hand, int value[]);
+int reference_ranking(Hand *hand);
+int reference_compare(Hand *hand1, Hand *hand2);
+long hand_equity(CardMask hole1, CardMask hole2, CardMask board, Equity *ep);
+double equity_share(Equity *ep);
+Ring *create_ring(int size);
+void free_ring(Ring *rp);
+void ring_put(Ring *rp, void *item);
+void *ring_get(Ring *rp);
+void ring_close(Ring *rp);
+HandWriter *create_hand_writer(FILE *fp, int hand_size, int flags, int block_hands);
+int write_hand(HandWriter *wp, CardMask m);
+void close_hand_writer(HandWriter *wp);
+HandReader *open_hand_reader(FILE *fp);
+uint64_t hand_reader_count(HandReader *rp);
+int read_hand(HandReader *rp, CardMask *mp, int *key);
+long read_hand_range(HandReader *rp, uint64_t first, long n, CardMask *masks, int *keys);
+void close_hand_reader(HandReader *rp);
+void philox(uint64_t counter, uint64_t block, uint64_t key, uint32_t out[4]);
+int random_below(uint32_t word, int n);
+void init_mc_result(McResult *rp, CardMask hole1, CardMask hole2, CardMask board, uint64_t key, uint64_t first);
+void monte_carlo(McResult *rp, uint64_t n);
+int merge_mc_result(McResult *into, McResult *from);
+double mc_equity(McResult *rp);
+double mc_error(McResult *rp);
+int write_mc_result(FILE *fp, McResult *rp);
+int read_mc_result(FILE *fp, McResult *rp);
+int parse_shard(char *spec, uint64_t total, uint64_t *first, uint64_t *count);
+int combo_index(CardMask combo);
+CardMask index_combo(int i);
+int rank_board(CardMask board, CardMask dead, BoardRanking *bp);
+void rank_boards(CardMask *boards, int n, CardMask dead, BoardRanking *out, int threads);
+double range_equity(BoardRanking *bp, double *range1, double *range2);
+void board_strengths(BoardRanking *bp, double *strength);
+long colex_index(CardMask m, int *cards);
+CardMask permute_suits(CardMask m, int perm);
+CardMask canonical_board(CardMask board, int *perm);
+void street_strengths(CardMask board, double *ehs, double *ehs2);
+StrengthTable *create_strength_table(char *path, int streets);
+StrengthTable *open_strength_table(char *path, int writable);
+int strength_table_boards(StrengthTable *tp, int street);
+CardMask strength_table_board(StrengthTable *tp, int street, int slot);
+int strength_slot_done(StrengthTable *tp, int street, int slot);
+void store_strengths(StrengthTable *tp, int street, int slot, double *ehs, double *ehs2);
+int checkpoint_strength_table(StrengthTable *tp, int complete);
+int strength_lookup(StrengthTable *tp, CardMask hole, CardMask board, double *ehs, double *ehs2);
+void close_strength_table(StrengthTable *tp);
+int showdown(CardMask *holes, int seats, CardMask board, int *keys, unsigned *winners);
+long split_pots(int *keys, long *bets, int seats, long *won);
+int starting_hand(CardMask hole);
+char *starting_hand_name(char *buffer, int hand);
+void init_table_stats(TableStats *sp, int seats, uint64_t key, uint64_t first);
+void simulate_table(TableStats *sp, uint64_t n);
+int merge_table_stats(TableStats *into, TableStats *from);
+void draw_outcomes(CardMask hand, DrawOutcome outcomes[32]);
+double draw_value(DrawOutcome *op, double *payouts);
+CardMask best_hold(CardMask hand, double *payouts, double *value);
+DrawTable *make_draw_table(double *payouts);
+CardMask draw_table_hold(DrawTable *tp, CardMask hand, double *value);
+void free_draw_table(DrawTable *tp);
+int estimate_equity(CardMask hole1, CardMask hole2, CardMask board, int mode, long n, uint64_t key, Estimate *ep);
+void init_history_stats(HistoryStats *sp);
+int log_showdown(HistoryStats *sp, char *line, char **end);
+void merge_history_stats(HistoryStats *into, HistoryStats *from);
+LookupTable *make_lookup_table(int threads);
+int lookup_strength(LookupTable *tp, CardMask m);
+void free_lookup_table(LookupTable *tp);
+int hand_to_inline(Hand *hand, InlineHand *ip);
+int mask_to_inline(CardMask m, InlineHand *ip);
+Hand *inline_to_hand(InlineHand *ip);
+InlineHand *create_inline_hands(long n);
@@ -0,0 +1,232 @@
+/* draw.c -- the best cards to hold in five-card draw
+
+Example:
+
+  DrawOutcome outcomes[32];
+  draw_outcomes(hand, outcomes);   // outcomes[h]: holding the cards in h
+  outcomes[h].counts[r]            // draws ending in ranking r (out of
+                                   // outcomes[h].draws)
+
+  double payouts[RANKINGS_N] = { 50, 25, 9, 6, 4, 3, 2, 1, 0 };
+  best_hold(hand, payouts, &value)   // the cards to keep, and what
+                                     // they're worth on average
+
+Bit i of a hold h stands for the hand's ith card from the bottom (by
+card index). Payouts are by ranking_data index, so they can be a pay
+table or each ranking's equity against some reference hand.
+
+Rather than dealing out every replacement (all 1,533,939 of them when
+drawing five), the counts come by inclusion and exclusion from how
+many five-card hands, out of the whole deck, hold each subset X of
+the hand and end up as each ranking, N(X):
+
+  counts(hold) = sum over T within the discards of (-1)^|T| N(hold + T)
+
+since the draws mustn't bring back any of the discards. The 32
+subsets' N are looked up once and shared by all 32 holds, which is
+243 sums all told. The N tables (of every one- to four-card set) take
+a pass over all 2,598,960 hands to make, done the first time they're
+wanted.
+
+make_draw_table solves each of the CANONICAL_FIVES (134,459) hands
+that are different up to suits once, so that draw_table_hold is a
+canonical_board, a binary search and a relabelling. It's NULL if
+there isn't the memory.
+
+*/
+
+#include "cards.h"
+#include <pthread.h>
+#include <string.h>
+
+#define DECK ((CARD_BIT(52)) - 1)
+
+static int *holding[5];
+static long everything[RANKINGS_N];
+static pthread_once_t made = PTHREAD_ONCE_INIT;
+
+static void make_holding(void)
+{
+    static int sizes[5] = { 1, 52, 1326, 22100, 270725 };
+    CardMask m, low, sub;
+    int i, k, ranking, cards[5];
+
+    for (k = 1; k < 5; k++) {
+	holding[k] = calloc((size_t)sizes[k] * RANKINGS_N, sizeof(int));
+    }
+    /* Every five-card hand, and each of its one- to four-card subsets */
+    for (m = CARD_BIT(5) - 1; m <= DECK; ) {
+	ranking = mask_ranking(m);
+	everything[ranking]++;
+	for (i = 0, sub = m; i < 5; i++, sub &= sub - 1) {
+	    cards[i] = __builtin_ctzll(sub);
+	}
+	for (i = 1; i < 31; i++) {
+	    sub = 0;
+	    for (k = 0; k < 5; k++) {
+		if (i & (1 << k)) {
+		    sub |= CARD_BIT(cards[k]);
+		}
+	    }
+	    holding[__builtin_popcount(i)][colex_index(sub, &k) * RANKINGS_N + ranking]++;
+	}
+	low = m & -m;
+	m = ((((m + low) ^ m) >> 2) / low) | (m + low);
+    }
+}
+
+void draw_outcomes(CardMask hand, DrawOutcome outcomes[32])
+{
+    long n[32][RANKINGS_N], sign;
+    CardMask cards[5], sub, m;
+    int i, j, k, r, t, hold;
+
+    pthread_once(&made, make_holding);
+    for (i = 0, m = hand; i < 5; i++, m &= m - 1) {
+	cards[i] = m & -m;
+    }
+    for (i = 0; i < 32; i++) {
+	for (j = 0, sub = 0; j < 5; j++) {
+	    if (i & (1 << j)) {
+		sub |= cards[j];
+	    }
+	}
+	k = __builtin_popcount(i);
+	if (k == 0) {
+	    memcpy(n[i], everything, sizeof(everything));
+	}
+	else if (k == 5) {
+	    memset(n[i], 0, sizeof(n[i]));
+	    n[i][mask_ranking(hand)] = 1;
+	}
+	else {
+	    int *counts = holding[k] + colex_index(sub, &j) * RANKINGS_N;
+	    for (r = 0; r < RANKINGS_N; r++) {
+		n[i][r] = counts[r];
+	    }
+	}
+    }
+
+    for (hold = 0; hold < 32; hold++) {
+	memset(&outcomes[hold], 0, sizeof(DrawOutcome));
+	/* Every t within the discards, as a submask of them */
+	for (t = 31 & ~hold; ; t = (t - 1) & ~hold & 31) {
+	    sign = (__builtin_popcount(t) & 1) ? -1 : 1;
+	    for (r = 0; r < RANKINGS_N; r++) {
+		outcomes[hold].counts[r] += sign * n[hold | t][r];
+	    }
+	    if (!t) {
+		break;
+	    }
+	}
+	for (r = 0; r < RANKINGS_N; r++) {
+	    outcomes[hold].draws += outcomes[hold].counts[r];
+	}
+    }
+}
+
+double draw_value(DrawOutcome *op, double *payouts)
+{
+    double total = 0;
+    int r;
+
+    for (r = 0; r < RANKINGS_N; r++) {
+	total += op->counts[r] * payouts[r];
+    }
+    return op->draws ? total / op->draws : 0;
+}
+
+/* The cards of hand to hold for the most on average, and that average
+   in value (if it isn't NULL) */
+
+CardMask best_hold(CardMask hand, double *payouts, double *value)
+{
+    DrawOutcome outcomes[32];
+    CardMask hold = 0, m;
+    double v, best = -1;
+    int i, j, h = 0;
+
+    draw_outcomes(hand, outcomes);
+    for (i = 0; i < 32; i++) {
+	if ((v = draw_value(&outcomes[i], payouts)) > best) {
+	    best = v;
+	    h = i;
+	}
+    }
+    for (j = 0, m = hand; j < 5; j++, m &= m - 1) {
+	if (h & (1 << j)) {
+	    hold |= m & -m;
+	}
+    }
+    if (value) {
+	*value = best;
+    }
+    return hold;
+}
+
+DrawTable *make_draw_table(double *payouts)
+{
+    DrawTable *tp = calloc(1, sizeof(DrawTable));
+    CardMask m, low;
+    int perm;
+
+    if (!tp) {
+	return NULL;
+    }
+    tp->hands = malloc(CANONICAL_FIVES * sizeof(CardMask));
+    tp->holds = malloc(CANONICAL_FIVES * sizeof(CardMask));
+    tp->values = malloc(CANONICAL_FIVES * sizeof(double));
+    if (!tp->hands || !tp->holds || !tp->values) {
+	free_draw_table(tp);
+	return NULL;
+    }
+    /* In colex order, which keeps the canonical hands sorted */
+    for (m = CARD_BIT(5) - 1; m <= DECK && tp->n < CANONICAL_FIVES; ) {
+	if (canonical_board(m, &perm) == m) {
+	    tp->hands[tp->n] = m;
+	    tp->holds[tp->n] = best_hold(m, payouts, &tp->values[tp->n]);
+	    tp->n++;
+	}
+	low = m & -m;
+	m = ((((m + low) ^ m) >> 2) / low) | (m + low);
+    }
+    return tp;
+}
+
+/* As best_hold, from the table; 0 (and no value) for anything but five
+   different cards */
+
+CardMask draw_table_hold(DrawTable *tp, CardMask hand, double *value)
+{
+    CardMask canonical;
+    int perm, low = 0, high = tp->n - 1, middle;
+
+    if (__builtin_popcountll(hand) != 5) {
+	return 0;
+    }
+    canonical = canonical_board(hand, &perm);
+    while (low < high) {
+	middle = (low + high) / 2;
+	if (tp->hands[middle] < canonical) {
+	    low = middle + 1;
+	}
+	else {
+	    high = middle;
+	}
+    }
+    if (value) {
+	*value = tp->values[low];
+    }
+    /* Back from the canonical hand's suits to this one's */
+    for (perm = 0; permute_suits(canonical, perm) != hand; perm++)
+	;
+    return permute_suits(tp->holds[low], perm);
+}
+
+void free_draw_table(DrawTable *tp)
+{
+    free(tp->hands);
+    free(tp->holds);
+    free(tp->values);
+    free(tp);
+}
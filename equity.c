@@ -0,0 +1,57 @@
+/* equity.c -- heads-up equity by dealing out every possible board
+
+Example:
+
+  CardMask aces = hand_mask(create_batch_hand("A of spades, A of hearts"));
+  CardMask kings = hand_mask(create_batch_hand("K of spades, K of hearts"));
+  Equity eq;
+
+  hand_equity(aces, kings, 0, &eq);    // 1712304 boards
+  eq.wins, eq.ties, eq.losses          // counted from the first hand's side
+  equity_share(&eq)                    // about 0.82, ties counting half
+
+The board can have anything from none to five cards already out; the
+rest are dealt from what's left of the deck in every combination.
+
+*/
+
+#include "cards.h"
+#include <string.h>
+
+#define DECK ((CARD_BIT(52)) - 1)
+
+static void deal(CardMask hole1, CardMask hole2, CardMask board,
+		 CardMask deck, int n, Equity *ep)
+{
+    CardMask card;
+    int key1, key2;
+
+    if (n == 0) {
+	key1 = mask_strength(hole1 | board);
+	key2 = mask_strength(hole2 | board);
+	if (key1 > key2) ep->wins++;
+	else if (key1 < key2) ep->losses++;
+	else ep->ties++;
+	return;
+    }
+    /* Cards go out in index order, so each board is dealt once */
+    while (__builtin_popcountll(deck) >= n) {
+	card = deck & -deck;
+	deck ^= card;
+	deal(hole1, hole2, board | card, deck, n - 1, ep);
+    }
+}
+
+long hand_equity(CardMask hole1, CardMask hole2, CardMask board, Equity *ep)
+{
+    memset(ep, 0, sizeof(Equity));
+    deal(hole1, hole2, board, DECK & ~(hole1 | hole2 | board),
+	 5 - __builtin_popcountll(board), ep);
+    return ep->wins + ep->ties + ep->losses;
+}
+
+double equity_share(Equity *ep)
+{
+    long total = ep->wins + ep->ties + ep->losses;
+    return total ? (ep->wins + ep->ties / 2.0) / total : 0;
+}
@@ -5,17 +5,32 @@
    handled by multiples_chooser. 
 */
 
+/* Compares the cards one by one from the top down, so that a tie on
+   the highest card goes to the next highest, and so on. */
+
 int high_card_chooser(Hand *hand1, Hand *hand2)
 {
-    Card *high1 = high_card(hand1);
-    Card *high2 = high_card(hand2);
-    return index_of_rank(high1->rank) - index_of_rank(high2->rank);
+    int i, j;
+    Card *copy1[hand1->len], *copy2[hand2->len];
+    copy_cards(hand1, copy1);
+    copy_cards(hand2, copy2);
+    qsort(copy1, hand1->len, sizeof(Card *), card_compare_for_qsort);
+    qsort(copy2, hand2->len, sizeof(Card *), card_compare_for_qsort);
+    for (i = hand1->len - 1, j = hand2->len - 1; i >= 0 && j >= 0; i--, j--) {
+	if (rank_difference(copy1[i], copy2[j])) {
+	    return rank_difference(copy1[i], copy2[j]);
+	}
+    }
+    return 0;
 }
 
+/* n_of_a_kind_hash collects kickers lowest first, so they're compared
+   from the end of the array. */
+
 static int high_kickers(int k1[], int k2[], int len)
 {
     int i, j;
-    for (i = 0; i < len; i++) {
+    for (i = len - 1; i >= 0; i--) {
 	j = k1[i] - k2[i];
 	if (j) {
 	    return j;
@@ -26,14 +41,16 @@ static int high_kickers(int k1[], int k2[], int len)
 
 static int multiples_chooser(Hand *hand1, Hand *hand2, int n)
 {
-    int buck1[13], buck2[13], result;
+    int result;
     Mult *mult1 = malloc(sizeof(Mult));
     Mult *mult2 = malloc(sizeof(Mult));
-    n_of_a_kind_hash(hand1, mult1, 2);
-    n_of_a_kind_hash(hand2, mult2, 2);
+    n_of_a_kind_hash(hand1, mult1, n);
+    n_of_a_kind_hash(hand2, mult2, n);
 
-    result = ((mult1->mult - mult2->mult) ||
-	      high_kickers(mult1->kickers, mult2->kickers, 3));
+    result = mult1->mult - mult2->mult;
+    if (!result) {
+	result = high_kickers(mult1->kickers, mult2->kickers, 5 - n);
+    }
 
     free(mult1);
     free(mult2);
@@ -43,7 +60,7 @@ static int multiples_chooser(Hand *hand1, Hand *hand2, int n)
 
 int pair_chooser(Hand *hand1, Hand *hand2)
 {
-    multiples_chooser(hand1, hand2, 2);
+    return multiples_chooser(hand1, hand2, 2);
 }
 
 int two_pair_chooser(Hand *hand1, Hand *hand2)
@@ -53,17 +70,29 @@ int two_pair_chooser(Hand *hand1, Hand *hand2)
 
 int trips_chooser(Hand *hand1, Hand *hand2)
 {
-    multiples_chooser(hand1, hand2, 3);
+    return multiples_chooser(hand1, hand2, 3);
+}
+
+/* The ace in a 5-high straight plays low, so it can't be left to
+   high_card_chooser. */
+
+static int straight_top(Hand *hand)
+{
+    Card *copy[hand->len];
+    copy_cards(hand, copy);
+    qsort(copy, hand->len, sizeof(Card *), card_compare_for_qsort);
+    return is_a_baby_straight(copy) ? index_of_rank("5")
+	: index_of_rank(copy[hand->len - 1]->rank);
 }
 
 int straight_chooser(Hand *hand1, Hand *hand2)
 {
-    high_card_chooser(hand1, hand2);
+    return straight_top(hand1) - straight_top(hand2);
 }
 
 int flush_chooser(Hand *hand1, Hand *hand2)
 {
-    high_card_chooser(hand1, hand2);
+    return high_card_chooser(hand1, hand2);
 }
 
 int full_house_chooser(Hand *hand1, Hand *hand2)
@@ -75,7 +104,7 @@ int full_house_chooser(Hand *hand1, Hand *hand2)
     int trip1 = rank_of_multiples(buck1, 3);
     int pair2 = rank_of_multiples(buck2, 2);
     int trip2 = rank_of_multiples(buck2, 3);
-    return (trip1 - trip2) || (pair1 - pair2);
+    return (trip1 != trip2) ? trip1 - trip2 : pair1 - pair2;
 }
 
 int fours_chooser(Hand *hand1, Hand *hand2)
@@ -85,7 +114,7 @@ int fours_chooser(Hand *hand1, Hand *hand2)
 
 int straight_flush_chooser(Hand *hand1, Hand *hand2)
 {
-    return high_card_chooser(hand1, hand2);
+    return straight_chooser(hand1, hand2);
 }
 
 
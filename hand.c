@@ -74,6 +74,7 @@ Hand *create_hand()
 {
     Hand *hp;
     init_hand(&hp);
+    return hp;
 }
 
 void free_hand(Hand *hp)
@@ -89,20 +90,20 @@ void free_hand(Hand *hp)
 Card *high_card(Hand *hand) {
     Card *copy[hand->len];
     copy_cards(hand, copy);
-    int i;
-    qsort(copy, 5, sizeof(Card *), card_compare_for_qsort);
+    qsort(copy, hand->len, sizeof(Card *), card_compare_for_qsort);
     return copy[hand->len - 1];
 }
 
 int hand_ranking(Hand *hand)
 {
     int i, r;
-    for (i = 0; i < sizeof(ranking_data[i].ranking); i++) {
+    for (i = 0; i < RANKINGS_N; i++) {
 	r = (*ranking_data[i].ranking_function)(hand);
 	if(r) {
 	    return i;
 	}
     }
+    return RANKINGS_N - 1;
 }
 
 char *hand_ranking_description(Hand *hand)
@@ -113,7 +114,7 @@ char *hand_ranking_description(Hand *hand)
 int ordinal_ranking(char *desc)
 {
     int i;
-    for (i = 0; i < 13; i++) {
+    for (i = 0; i < RANKINGS_N; i++) {
 	if (!strcmp(desc, ranking_data[i].ranking)) {
 	    return i;
 	}
@@ -148,14 +149,15 @@ Hand *create_batch_hand(char *card_info)
 {
     char rank[3], suit[10];
     Hand *hand = create_hand();
-    char *cp = card_info;
-    int i = 0;
-    sscanf(cp, "%s of %[a-z]s\n", rank, suit);
-    add_card_to_hand(hand, rank, suit);
-    while(cp = strchr(cp+1, ',')) { 
- 	sscanf(cp, ", %s of %[a-z]s\n", rank, suit);	 
- 	add_card_to_hand(hand, rank, suit); 
-    } 
+    char *cp;
+    if (sscanf(card_info, "%2s of %9[a-z]", rank, suit) == 2) {
+	add_card_to_hand(hand, rank, suit);
+    }
+    for (cp = strchr(card_info, ','); cp; cp = strchr(cp + 1, ',')) {
+	if (sscanf(cp, ", %2s of %9[a-z]", rank, suit) == 2) {
+	    add_card_to_hand(hand, rank, suit);
+	}
+    }
     return hand;
 }
 
@@ -174,7 +176,7 @@ void n_of_a_kind_hash(Hand *hand, Mult *mp, int n)
     }
 }
 
-int make_rankings_histogram(Hand *hand, int buckets[]) {
+void make_rankings_histogram(Hand *hand, int buckets[]) {
     int i,j;
     Card **cp = hand->cards;
     for (i = 0; i < 13; i++) {
@@ -196,22 +198,22 @@ int eval_profile(Hand *hand, char *profile) {
  
 int hand_has_nothing(Hand *hand)
 {
-    eval_profile(hand, "11111");
+    return eval_profile(hand, "11111");
 }
 
 int hand_has_pair(Hand *hand)
 {
-    eval_profile(hand, "1112");
+    return eval_profile(hand, "1112");
 }
 
 int hand_has_two_pair(Hand *hand)
 {
-    eval_profile(hand, "122");
+    return eval_profile(hand, "122");
 }
 
 int hand_has_three_of_a_kind(Hand *hand)
 {
-    eval_profile(hand, "113");
+    return eval_profile(hand, "113");
 }
 
 void copy_cards(Hand *hand, Card **copy) {
@@ -258,12 +260,12 @@ int hand_has_flush(Hand *hand)
 
 int hand_has_full_house(Hand *hand)
 {
-    eval_profile(hand, "23");
+    return eval_profile(hand, "23");
 }
 
 int hand_has_four_of_a_kind(Hand *hand)
 {
-    eval_profile(hand, "14");
+    return eval_profile(hand, "14");
 }
 
 int hand_has_straight_flush(Hand *hand)
@@ -0,0 +1,367 @@
+/* handfile.c -- a compact binary format for storing lots of hands
+
+Writing:
+
+  HandWriter *wp = create_hand_writer(fp, 7, HANDS_PACKED | HANDS_STRENGTH, 0);
+  write_hand(wp, mask);          // once per hand
+  close_hand_writer(wp);         // writes the last block; fp stays open
+
+Reading, in order:
+
+  HandReader *rp = open_hand_reader(fp);
+  while (read_hand(rp, &mask, &key))
+      ...
+  close_hand_reader(rp);
+
+or, when the file could be mapped, any stretch at all (so threads can
+split a file between them):
+
+  read_hand_range(rp, first, n, masks, keys);
+
+A file is a HandFileHeader and then blocks of block_hands hands, each
+block a HandBlockHeader, the hands, and, with HANDS_STRENGTH, their
+strength keys. Hands are stored as 8-byte CardMasks, or with
+HANDS_PACKED as hand_size bytes of card indices, lowest first. Every
+block but the last is full, so block k always starts at
+
+  sizeof(HandFileHeader) + k * block_bytes
+
+Numbers are in host byte order. If the header's count is HANDS_UNKNOWN
+(because the file was written down a pipe) readers count the blocks.
+
+*/
+
+#include "cards.h"
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define BLOCK_MARKER 0x4b4c4243    /* "CBLK" */
+
+struct hand_writer {
+    FILE *fp;
+    HandFileHeader header;
+    CardMask *masks;
+    int n;
+    long start;
+};
+
+struct hand_reader {
+    FILE *fp;
+    HandFileHeader header;
+    unsigned char *map;
+    size_t map_size;
+    CardMask *masks;
+    int *keys;
+    uint32_t n, next;
+    uint64_t count;
+};
+
+static size_t record_size(HandFileHeader *hp)
+{
+    return (hp->flags & HANDS_PACKED) ? hp->hand_size : sizeof(CardMask);
+}
+
+static size_t block_bytes(HandFileHeader *hp, uint32_t hands)
+{
+    size_t per_hand = record_size(hp);
+    if (hp->flags & HANDS_STRENGTH) {
+	per_hand += sizeof(int32_t);
+    }
+    return sizeof(HandBlockHeader) + hands * per_hand;
+}
+
+static void pack_mask(unsigned char *out, CardMask m, int size)
+{
+    int i, n = 0;
+    for (i = 0; i < 52 && n < size; i++) {
+	if (m & CARD_BIT(i)) {
+	    out[n++] = i;
+	}
+    }
+}
+
+static CardMask unpack_mask(unsigned char *in, int size)
+{
+    CardMask m = 0;
+    int i;
+    for (i = 0; i < size; i++) {
+	if (in[i] < 52) {
+	    m |= CARD_BIT(in[i]);
+	}
+    }
+    return m;
+}
+
+/* Lays out one block's records (and keys) after its header */
+
+static void encode_block(HandFileHeader *hp, unsigned char *out, CardMask *masks, int n)
+{
+    HandBlockHeader block = { n, BLOCK_MARKER };
+    size_t size = record_size(hp);
+    int32_t key;
+    int i;
+
+    memcpy(out, &block, sizeof(block));
+    out += sizeof(block);
+    for (i = 0; i < n; i++, out += size) {
+	if (hp->flags & HANDS_PACKED) {
+	    pack_mask(out, masks[i], size);
+	}
+	else {
+	    memcpy(out, &masks[i], size);
+	}
+    }
+    if (hp->flags & HANDS_STRENGTH) {
+	for (i = 0; i < n; i++, out += sizeof(key)) {
+	    key = mask_strength(masks[i]);
+	    memcpy(out, &key, sizeof(key));
+	}
+    }
+}
+
+/* Reads hands [first, first + n) of a block that starts at in */
+
+static void decode_block(HandFileHeader *hp, unsigned char *in, uint32_t hands,
+			 uint32_t first, uint32_t n, CardMask *masks, int *keys)
+{
+    size_t size = record_size(hp);
+    unsigned char *records = in + sizeof(HandBlockHeader);
+    uint32_t i;
+
+    for (i = 0; i < n; i++) {
+	if (hp->flags & HANDS_PACKED) {
+	    masks[i] = unpack_mask(records + (first + i) * size, size);
+	}
+	else {
+	    memcpy(&masks[i], records + (first + i) * size, size);
+	}
+    }
+    if (keys && (hp->flags & HANDS_STRENGTH)) {
+	memcpy(keys, records + hands * size + first * sizeof(int32_t),
+	       n * sizeof(int32_t));
+    }
+    else if (keys) {
+	mask_strengths(masks, keys, n);
+    }
+}
+
+HandWriter *create_hand_writer(FILE *fp, int hand_size, int flags, int block_hands)
+{
+    HandWriter *wp = calloc(1, sizeof(HandWriter));
+    if ((flags & HANDS_PACKED) && (hand_size < 1 || hand_size > 7)) {
+	free(wp);
+	return NULL;
+    }
+    memcpy(wp->header.magic, HANDS_MAGIC, 4);
+    wp->header.version = HANDS_VERSION;
+    wp->header.hand_size = hand_size;
+    wp->header.flags = flags;
+    wp->header.block_hands = block_hands > 0 ? block_hands : HANDS_BLOCK;
+    wp->header.count = HANDS_UNKNOWN;
+    wp->fp = fp;
+    wp->masks = malloc(wp->header.block_hands * sizeof(CardMask));
+    wp->start = ftell(fp);
+    fwrite(&wp->header, sizeof(HandFileHeader), 1, fp);
+    wp->header.count = 0;
+    return wp;
+}
+
+static void flush_block(HandWriter *wp)
+{
+    size_t size = block_bytes(&wp->header, wp->n);
+    unsigned char *out = malloc(size);
+    encode_block(&wp->header, out, wp->masks, wp->n);
+    fwrite(out, 1, size, wp->fp);
+    free(out);
+    wp->n = 0;
+}
+
+/* Returns -1, and writes nothing, for a hand that doesn't fit the
+   packed size. */
+
+int write_hand(HandWriter *wp, CardMask m)
+{
+    if ((wp->header.flags & HANDS_PACKED)
+	&& __builtin_popcountll(m) != wp->header.hand_size) {
+	return -1;
+    }
+    wp->masks[wp->n++] = m;
+    wp->header.count++;
+    if (wp->n == wp->header.block_hands) {
+	flush_block(wp);
+    }
+    return 0;
+}
+
+/* Finishes the last block, and fills in the count if the file can be
+   rewound to the header. */
+
+void close_hand_writer(HandWriter *wp)
+{
+    long end;
+    if (wp->n) {
+	flush_block(wp);
+    }
+    end = ftell(wp->fp);
+    if (wp->start >= 0 && end >= 0 && !fseek(wp->fp, wp->start, SEEK_SET)) {
+	fwrite(&wp->header, sizeof(HandFileHeader), 1, wp->fp);
+	fseek(wp->fp, end, SEEK_SET);
+    }
+    fflush(wp->fp);
+    free(wp->masks);
+    free(wp);
+}
+
+/* Mapped block k, or NULL if it doesn't have its marker, says it has
+   more hands than a block holds, or runs past the end of the map */
+
+static unsigned char *mapped_block(HandReader *rp, uint64_t k)
+{
+    size_t full = block_bytes(&rp->header, rp->header.block_hands);
+    size_t at = sizeof(HandFileHeader) + k * full;
+    HandBlockHeader block;
+
+    if (at + sizeof(block) > rp->map_size || k > (rp->map_size - sizeof(HandFileHeader)) / full) {
+	return NULL;
+    }
+    memcpy(&block, rp->map + at, sizeof(block));
+    if (block.marker != BLOCK_MARKER || block.hands > rp->header.block_hands
+	|| at + block_bytes(&rp->header, block.hands) > rp->map_size) {
+	return NULL;
+    }
+    return rp->map + at;
+}
+
+HandReader *open_hand_reader(FILE *fp)
+{
+    HandReader *rp = calloc(1, sizeof(HandReader));
+    struct stat st;
+    size_t full, blocks;
+    uint64_t fits;
+    unsigned char *tail;
+
+    rp->fp = fp;
+    if (fread(&rp->header, sizeof(HandFileHeader), 1, fp) != 1
+	|| memcmp(rp->header.magic, HANDS_MAGIC, 4)
+	|| rp->header.version != HANDS_VERSION
+	|| rp->header.block_hands == 0) {
+	free(rp);
+	return NULL;
+    }
+    rp->count = rp->header.count;
+    rp->masks = malloc(rp->header.block_hands * sizeof(CardMask));
+    rp->keys = malloc(rp->header.block_hands * sizeof(int));
+
+    /* Map the file if we can; otherwise it gets read block by block */
+    if (!fstat(fileno(fp), &st) && S_ISREG(st.st_mode) && ftell(fp) == sizeof(HandFileHeader)) {
+	rp->map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fileno(fp), 0);
+	if (rp->map == MAP_FAILED) {
+	    rp->map = NULL;
+	}
+	else {
+	    rp->map_size = st.st_size;
+	}
+    }
+    /* No more hands than the file has room for, whatever the header
+       says (or if it didn't say) */
+    if (rp->map) {
+	full = block_bytes(&rp->header, rp->header.block_hands);
+	blocks = (rp->map_size - sizeof(HandFileHeader)) / full;
+	fits = (uint64_t)blocks * rp->header.block_hands;
+	if ((tail = mapped_block(rp, blocks))) {
+	    fits += ((HandBlockHeader *)tail)->hands;
+	}
+	if (rp->count > fits) {
+	    rp->count = fits;
+	}
+    }
+    return rp;
+}
+
+/* The number of hands, or HANDS_UNKNOWN for a stream that didn't say */
+
+uint64_t hand_reader_count(HandReader *rp)
+{
+    return rp->count;
+}
+
+/* Hands [first, first + n), or as many as there are. Returns how many
+   were read, or -1 if the file isn't mapped or a block it came to was
+   corrupt. */
+
+long read_hand_range(HandReader *rp, uint64_t first, long n, CardMask *masks, int *keys)
+{
+    uint64_t per_block = rp->header.block_hands, block;
+    unsigned char *in;
+    uint32_t offset, hands, take;
+    long done = 0;
+
+    if (!rp->map) {
+	return -1;
+    }
+    while (done < n && first < rp->count) {
+	block = first / per_block;
+	offset = first % per_block;
+	if (!(in = mapped_block(rp, block))
+	    || (hands = ((HandBlockHeader *)in)->hands) <= offset) {
+	    return -1;
+	}
+	take = hands - offset < n - done ? hands - offset : n - done;
+	decode_block(&rp->header, in, hands, offset, take,
+		     masks + done, keys ? keys + done : NULL);
+	done += take;
+	first += take;
+    }
+    return done;
+}
+
+static int next_block(HandReader *rp)
+{
+    HandBlockHeader block;
+    unsigned char *in;
+    size_t size;
+
+    if (fread(&block, sizeof(block), 1, rp->fp) != 1
+	|| block.marker != BLOCK_MARKER || block.hands > rp->header.block_hands) {
+	return 0;
+    }
+    size = block_bytes(&rp->header, block.hands);
+    in = malloc(size);
+    memcpy(in, &block, sizeof(block));
+    if (fread(in + sizeof(block), 1, size - sizeof(block), rp->fp) != size - sizeof(block)) {
+	free(in);
+	return 0;
+    }
+    decode_block(&rp->header, in, block.hands, 0, block.hands, rp->masks, rp->keys);
+    free(in);
+    rp->n = block.hands;
+    rp->next = 0;
+    return rp->n > 0;
+}
+
+/* The next hand in the file, and its strength key if key isn't NULL.
+   Returns 0 at the end. */
+
+int read_hand(HandReader *rp, CardMask *mp, int *key)
+{
+    if (rp->next == rp->n && !next_block(rp)) {
+	return 0;
+    }
+    *mp = rp->masks[rp->next];
+    if (key) {
+	*key = rp->keys[rp->next];
+    }
+    rp->next++;
+    return 1;
+}
+
+void close_hand_reader(HandReader *rp)
+{
+    if (rp->map) {
+	munmap(rp->map, rp->map_size);
+    }
+    free(rp->masks);
+    free(rp->keys);
+    free(rp);
+}
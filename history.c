@@ -0,0 +1,128 @@
+/* history.c -- tallies from logs of hands that went to showdown
+
+Example:
+
+  HistoryStats stats;
+  init_history_stats(&stats);
+  while (p < end)
+      log_showdown(&stats, p, &p);      // one line, p moves past it
+  merge_history_stats(&all, &stats);    // say, from each thread's share
+
+A log has one hand a line, in fields separated by semicolons, each
+field cards in create_batch_hand's form: the flop, the turn, the river
+and then the hole cards of each seat (two to SEATS_MAX of them) that
+showed down:
+
+  A of spades, 7 of hearts, 2 of clubs; K of diamonds; 7 of clubs; A of hearts, Q of clubs; 7 of spades, 7 of diamonds
+
+Blank lines and ones starting with # are passed over; any other line
+that isn't that shape (a card twice, too few seats, a field with the
+wrong number of cards) is counted in rejected and skipped.
+
+For each hand the stats get every seat's ranking and whether it won,
+and, like simulate_table, each starting hand's wins, splits and share
+of the pot in 1/SHARE_UNIT pots. The seat that was ahead on the flop
+(and on the turn), if only one was, counts in leads[], and in held[]
+if it went on to win or split the pot: how often the best hand then
+was the best hand at the end.
+
+The board and the holes are evaluated with showdown, so it's one
+suit_masks_strength a seat a street. The stats are plain counts that
+add, so threads keep their own and merge them at the end.
+
+*/
+
+#include "cards.h"
+#include <string.h>
+
+void init_history_stats(HistoryStats *sp)
+{
+    memset(sp, 0, sizeof(HistoryStats));
+}
+
+/* Reads the line at line, adds it to the stats and sets *end to the
+   start of the next. Returns the number of seats, 0 for a line that's
+   blank or a comment, or -1 for one that's rejected. The line has to
+   end in a newline or a '\0'. */
+
+int log_showdown(HistoryStats *sp, char *line, char **end)
+{
+    CardMask fields[3 + SEATS_MAX], seen = 0, board, m;
+    char *p = line;
+    int n = 0, bad = 0, seats, cards, keys[SEATS_MAX], i, kind, share;
+    unsigned lead, winners;
+
+    while (*p == ' ' || *p == '\t') p++;
+    if (*p == '#' || *p == '\n' || *p == '\r' || !*p) {
+	p += strcspn(p, "\n");
+	*end = p + (*p == '\n');
+	return 0;
+    }
+    for (;;) {
+	cards = text_to_mask(p, &m, &p);
+	if (n == 3 + SEATS_MAX || cards != (n == 0 ? 3 : n < 3 ? 1 : 2) || (m & seen)) {
+	    bad = 1;
+	    break;
+	}
+	seen |= m;
+	fields[n++] = m;
+	if (*p != ';') {
+	    break;
+	}
+	p++;
+    }
+    p += strcspn(p, "\n");
+    *end = p + (*p == '\n');
+    if (bad || n < 5) {
+	sp->rejected++;
+	return -1;
+    }
+
+    seats = n - 3;
+    board = fields[0] | fields[1] | fields[2];
+    showdown(fields + 3, seats, board, keys, &winners);
+    for (i = 0, board = fields[0]; i < 2; board |= fields[1 + i], i++) {
+	showdown(fields + 3, seats, board, NULL, &lead);
+	if (__builtin_popcount(lead) == 1) {
+	    sp->leads[i]++;
+	    sp->held[i] += (winners & lead) != 0;
+	}
+    }
+
+    sp->hands++;
+    share = SHARE_UNIT / __builtin_popcount(winners);
+    for (i = 0; i < seats; i++) {
+	kind = starting_hand(fields[3 + i]);
+	sp->shown[STRENGTH_RANKING(keys[i])]++;
+	sp->dealt[kind]++;
+	if (winners & (1u << i)) {
+	    sp->won[STRENGTH_RANKING(keys[i])]++;
+	    sp->wins[kind] += winners == 1u << i;
+	    sp->ties[kind] += winners != 1u << i;
+	    sp->shares[kind] += share;
+	}
+    }
+    return seats;
+}
+
+void merge_history_stats(HistoryStats *into, HistoryStats *from)
+{
+    int i;
+
+    into->hands += from->hands;
+    into->rejected += from->rejected;
+    for (i = 0; i < 2; i++) {
+	into->leads[i] += from->leads[i];
+	into->held[i] += from->held[i];
+    }
+    for (i = 0; i < RANKINGS_N; i++) {
+	into->shown[i] += from->shown[i];
+	into->won[i] += from->won[i];
+    }
+    for (i = 0; i < STARTING_HANDS; i++) {
+	into->dealt[i] += from->dealt[i];
+	into->wins[i] += from->wins[i];
+	into->ties[i] += from->ties[i];
+	into->shares[i] += from->shares[i];
+    }
+}
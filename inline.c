@@ -0,0 +1,98 @@
+/* inline.c -- hands of up to seven cards in one cache line
+
+Example:
+
+  InlineHand h;
+  hand_to_inline(hand, &h);        // from a Hand; -1 if it won't fit
+  mask_strength(h.mask);           // the mask is always there
+  h.rank_counts[12]                // how many aces
+  Hand *copy = inline_to_hand(&h); // and back, cards in the same order
+
+  InlineHand *hands = create_inline_hands(n);   // 64-byte aligned
+  ...
+  free(hands);
+
+A Hand is a pointer to an array of pointers to Cards, each pointing at
+its own rank and suit strings, so reading one takes a cache line for
+every piece. An InlineHand holds the card indices themselves, the
+mask and the rank and suit counts in 64 bytes, aligned to 64: a plain
+value that can live on the stack or in an array and be copied with
+memcpy or =, so going through an array of them is a straight read.
+
+*/
+
+#include "cards.h"
+#include <string.h>
+
+extern char *ranks[];
+extern char *suits[];
+
+_Static_assert(sizeof(InlineHand) == 64, "an InlineHand should be one cache line");
+
+static void add_card(InlineHand *ip, int index)
+{
+    ip->cards[ip->len++] = index;
+    ip->mask |= CARD_BIT(index);
+    ip->rank_counts[index % 13]++;
+    ip->suit_counts[index / 13]++;
+}
+
+/* Copies a Hand's cards across in order. Returns -1, leaving *ip
+   empty, for more than INLINE_CARDS cards, a card that isn't one, or
+   a card twice. */
+
+int hand_to_inline(Hand *hand, InlineHand *ip)
+{
+    int i, index;
+
+    memset(ip, 0, sizeof(InlineHand));
+    if (hand->len > INLINE_CARDS) {
+	return -1;
+    }
+    for (i = 0; i < hand->len; i++) {
+	index = card_index(hand->cards[i]);
+	if (index < 0 || (ip->mask & CARD_BIT(index))) {
+	    memset(ip, 0, sizeof(InlineHand));
+	    return -1;
+	}
+	add_card(ip, index);
+    }
+    return 0;
+}
+
+/* The cards of m, lowest index first, as mask_to_hand; -1 (and *ip
+   empty) for more than INLINE_CARDS */
+
+int mask_to_inline(CardMask m, InlineHand *ip)
+{
+    memset(ip, 0, sizeof(InlineHand));
+    if (__builtin_popcountll(m) > INLINE_CARDS) {
+	return -1;
+    }
+    for (; m; m &= m - 1) {
+	add_card(ip, __builtin_ctzll(m));
+    }
+    return 0;
+}
+
+Hand *inline_to_hand(InlineHand *ip)
+{
+    Hand *hand = create_hand();
+    int i;
+
+    for (i = 0; i < ip->len; i++) {
+	add_card_to_hand(hand, ranks[ip->cards[i] % 13], suits[ip->cards[i] / 13]);
+    }
+    return hand;
+}
+
+/* An array of n, zeroed and on a cache line boundary; free() it */
+
+InlineHand *create_inline_hands(long n)
+{
+    InlineHand *hands = aligned_alloc(64, n * sizeof(InlineHand));
+    if (hands) {
+	memset(hands, 0, n * sizeof(InlineHand));
+    }
+    return hands;
+}
@@ -0,0 +1,132 @@
+/* lookup.c -- a whole 7-card table, for hosts with memory to spare
+
+Example:
+
+  LookupTable *tp = want_table ? make_lookup_table(threads) : NULL;
+  lookup_strength(tp, m);     // the same key as mask_strength(m)
+  free_lookup_table(tp);
+
+mask_strength needs only its rank tables (mask_table_bytes(), 48K or
+so, at home in L1 and L2) and works the hand out from the suit masks
+each time. This is the other end of the trade: every one of the
+133,784,560 sets of seven cards, in colex order, with its strength
+class, so that a hand is a colex_index and two loads. The classes are
+the 7,462 different five-card keys numbered in order of strength, in
+16 bits each, so the table is 267MB and comparing classes is the same
+as comparing keys.
+
+It only pays where the hands come in some order (enumerating boards
+or ranges, say) so that neighbouring lookups share cache lines: with
+hands in random order nearly every lookup misses all the way out to
+memory and it's several times slower than mask_strength.
+
+With a NULL table, or for anything but seven cards, lookup_strength is
+mask_strength, so what's built at start-up picks the evaluator and
+callers don't change. tools/evalbench measures both.
+
+*/
+
+#include "cards.h"
+#include <pthread.h>
+#include <string.h>
+
+#define DECK ((CARD_BIT(52)) - 1)
+#define HANDS_7 133784560L
+
+typedef struct {
+    LookupTable *tp;
+    uint16_t *class_of;
+    int next;
+} Fill;
+
+/* Takes top cards, from the 51 down, and fills in every hand with
+   that as its highest card */
+
+static void *fill(void *arg)
+{
+    Fill *fp = arg;
+    CardMask m, low, end;
+    long i;
+    int top, k;
+
+    while ((top = __sync_fetch_and_sub(&fp->next, 1)) >= 6) {
+	m = (CARD_BIT(6) - 1) | CARD_BIT(top);
+	end = CARD_BIT(top + 1);
+	for (i = colex_index(m, &k); m < end; i++) {
+	    fp->tp->classes[i] = fp->class_of[mask_strength(m)];
+	    low = m & -m;
+	    m = ((((m + low) ^ m) >> 2) / low) | (m + low);
+	}
+    }
+    return NULL;
+}
+
+LookupTable *make_lookup_table(int threads)
+{
+    LookupTable *tp = calloc(1, sizeof(LookupTable));
+    pthread_t *ids;
+    CardMask m, low;
+    Fill f;
+    int key, i, started;
+
+    if (!tp) {
+	return NULL;
+    }
+    tp->classes = malloc(HANDS_7 * sizeof(uint16_t));
+    f.class_of = calloc(1 << 24, sizeof(uint16_t));
+    if (!tp->classes || !f.class_of) {
+	free(f.class_of);
+	free_lookup_table(tp);
+	return NULL;
+    }
+    /* Every key a best five can have, numbered in order */
+    for (m = CARD_BIT(5) - 1; m <= DECK; ) {
+	f.class_of[mask_strength(m)] = 1;
+	low = m & -m;
+	m = ((((m + low) ^ m) >> 2) / low) | (m + low);
+    }
+    for (key = 0; key < 1 << 24; key++) {
+	if (f.class_of[key]) {
+	    tp->keys[tp->n] = key;
+	    f.class_of[key] = tp->n++;
+	}
+    }
+
+    f.tp = tp;
+    f.next = 51;
+    threads = threads < 1 ? 1 : threads;
+    ids = malloc(threads * sizeof(pthread_t));
+    for (started = 0; ids && started < threads; started++) {
+	if (pthread_create(&ids[started], NULL, fill, &f) != 0) {
+	    break;
+	}
+    }
+    /* Whatever the threads that did start haven't taken, this one
+       does, so the table is whole however many there were */
+    fill(&f);
+    for (i = 0; i < started; i++) {
+	pthread_join(ids[i], NULL);
+    }
+    free(ids);
+    free(f.class_of);
+    tp->bytes = HANDS_7 * sizeof(uint16_t) + sizeof(LookupTable);
+    return tp;
+}
+
+int lookup_strength(LookupTable *tp, CardMask m)
+{
+    int k;
+
+    if (tp && __builtin_popcountll(m) == 7) {
+	return tp->keys[tp->classes[colex_index(m, &k)]];
+    }
+    return mask_strength(m);
+}
+
+void free_lookup_table(LookupTable *tp)
+{
+    if (tp) {
+	free(tp->classes);
+	free(tp);
+    }
+}
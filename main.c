@@ -1,9 +1,241 @@
+/* main.c -- ccards, a streaming front end to the evaluator
+
+  ccards [-m describe|rank|compare] [file ...]
+
+Reads hands in create_batch_hand's form, one per line, from the files
+given or from stdin. A line may hold two hands separated by a ';'.
+For each line it writes one line:
+
+  describe   the ranking, as hand_ranking_description gives it
+  rank       the ranking_data index and the strength key, in hex
+  compare    1, -1 or 0 as the first hand beats, loses to or ties
+             with the second
+
+With two hands on a line, describe and rank give both, separated by a
+';'. Lines that don't parse come out as "?".
+
+Reading and parsing, evaluating, and formatting and writing each have
+a thread, and pass chunks of lines along bounded rings, so the output
+stays in input order. At the end the line count and rate go to stderr.
+A file that can't be opened or read is reported and passed over, and
+the exit status is then 1.
+
+*/
+
 #include "cards.h"
-char *make_profile(Hand *, char *);
-int main() {
-    Hand *hand;
-    hand = create_batch_hand("A of clubs, 3 of diamonds, 2 of hearts, 2 of spades, 2 of clubs");
-    char pstr[6];
-    char *profile = make_profile(hand, pstr); 
-    printf("profile: %s\n", pstr);
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CHUNK_LINES 4096
+#define RING_CHUNKS 16
+#define READ_SIZE (1 << 20)
+
+typedef struct {
+    int n;
+    CardMask hands[CHUNK_LINES][2];
+    signed char count[CHUNK_LINES];
+    int keys[CHUNK_LINES][2];
+} chunk;
+
+enum { DESCRIBE, RANK, COMPARE };
+
+static Ring *parsed, *evaluated;
+static char **files;
+static int nfiles, failed;
+static long lines, bytes;
+
+static void parse_line(chunk *cp, char *line)
+{
+    char *end;
+    int i = cp->n++;
+
+    cp->count[i] = -1;
+    if (text_to_mask(line, &cp->hands[i][0], &end) <= 0) {
+	return;
+    }
+    if (*end != ';') {
+	cp->count[i] = 1;
+    }
+    else if (text_to_mask(end + 1, &cp->hands[i][1], &end) > 0
+	     && (*end == '\0' || *end == '\n' || *end == '\r')) {
+	cp->count[i] = 2;
+    }
+}
+
+/* Passes on every complete line in buf and returns how much of it
+   that used up. At the end of the input, the rest is a line too. */
+
+static size_t parse_lines(char *buf, size_t len, chunk **cpp, int at_end)
+{
+    char *p = buf, *nl;
+
+    while (p < buf + len && ((nl = memchr(p, '\n', buf + len - p)) || at_end)) {
+	if (!nl) {
+	    buf[len] = '\0';
+	    nl = buf + len;
+	}
+	parse_line(*cpp, p);
+	if ((*cpp)->n == CHUNK_LINES) {
+	    ring_put(parsed, *cpp);
+	    *cpp = calloc(1, sizeof(chunk));
+	}
+	p = nl + 1;
+    }
+    return at_end ? len : p - buf;
+}
+
+static void *read_input(void *arg)
+{
+    size_t size = READ_SIZE, len = 0, used, n;
+    char *buf = malloc(size + 1);
+    chunk *cp = calloc(1, sizeof(chunk));
+    FILE *fp;
+    int i;
+
+    for (i = 0; i < (nfiles ? nfiles : 1); i++) {
+	fp = nfiles ? fopen(files[i], "r") : stdin;
+	if (!fp) {
+	    perror(files[i]);
+	    failed = 1;
+	    continue;
+	}
+	while ((n = fread(buf + len, 1, size - len, fp)) > 0) {
+	    bytes += n;
+	    len += n;
+	    used = parse_lines(buf, len, &cp, 0);
+	    memmove(buf, buf + used, len - used);
+	    len -= used;
+	    if (len == size) {
+		size *= 2;
+		buf = realloc(buf, size + 1);
+	    }
+	}
+	if (ferror(fp)) {
+	    perror(nfiles ? files[i] : "stdin");
+	    failed = 1;
+	}
+	parse_lines(buf, len, &cp, 1);
+	len = 0;
+	if (fp != stdin) {
+	    fclose(fp);
+	}
+    }
+    ring_put(parsed, cp);
+    ring_close(parsed);
+    free(buf);
+    return NULL;
+}
+
+static void *evaluate(void *arg)
+{
+    chunk *cp;
+    int i;
+    while ((cp = ring_get(parsed))) {
+	for (i = 0; i < cp->n; i++) {
+	    if (cp->count[i] > 0) {
+		cp->keys[i][0] = mask_strength(cp->hands[i][0]);
+	    }
+	    if (cp->count[i] > 1) {
+		cp->keys[i][1] = mask_strength(cp->hands[i][1]);
+	    }
+	}
+	ring_put(evaluated, cp);
+    }
+    ring_close(evaluated);
+    return NULL;
+}
+
+static char *format_key(char *out, int key)
+{
+    static char hex[] = "0123456789abcdef";
+    int shift;
+    out += sprintf(out, "%d ", STRENGTH_RANKING(key));
+    for (shift = 20; shift >= 0; shift -= 4) {
+	*out++ = hex[(key >> shift) & 0xf];
+    }
+    return out;
+}
+
+static char *format_line(char *out, int mode, int count, int keys[])
+{
+    int i;
+    if (count < 0 || (mode == COMPARE && count != 2)) {
+	*out++ = '?';
+    }
+    else if (mode == COMPARE) {
+	if (keys[0] < keys[1]) *out++ = '-';
+	*out++ = keys[0] == keys[1] ? '0' : '1';
+    }
+    else {
+	for (i = 0; i < count; i++) {
+	    if (i) *out++ = ';';
+	    if (mode == RANK) {
+		out = format_key(out, keys[i]);
+	    }
+	    else {
+		strcpy(out, strength_description(keys[i]));
+		out += strlen(out);
+	    }
+	}
+    }
+    *out++ = '\n';
+    return out;
+}
+
+static void write_output(int mode)
+{
+    static char out[CHUNK_LINES * 64];
+    char *p;
+    chunk *cp;
+    int i;
+
+    while ((cp = ring_get(evaluated))) {
+	for (i = 0, p = out; i < cp->n; i++) {
+	    p = format_line(p, mode, cp->count[i], cp->keys[i]);
+	}
+	fwrite(out, 1, p - out, stdout);
+	lines += cp->n;
+	free(cp);
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+    int c, mode = DESCRIBE;
+    pthread_t reader, evaluator;
+    struct timespec start, stop;
+    double seconds;
+
+    while ((c = getopt(argc, argv, "m:")) != -1) {
+	if (c == 'm' && !strcmp(optarg, "describe")) mode = DESCRIBE;
+	else if (c == 'm' && !strcmp(optarg, "rank")) mode = RANK;
+	else if (c == 'm' && !strcmp(optarg, "compare")) mode = COMPARE;
+	else {
+	    fprintf(stderr, "usage: %s [-m describe|rank|compare] [file ...]\n", argv[0]);
+	    return 2;
+	}
+    }
+    files = argv + optind;
+    nfiles = argc - optind;
+    setvbuf(stdout, NULL, _IOFBF, READ_SIZE);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    parsed = create_ring(RING_CHUNKS);
+    evaluated = create_ring(RING_CHUNKS);
+    pthread_create(&reader, NULL, read_input, NULL);
+    pthread_create(&evaluator, NULL, evaluate, NULL);
+    write_output(mode);
+    pthread_join(reader, NULL);
+    pthread_join(evaluator, NULL);
+    free_ring(parsed);
+    free_ring(evaluated);
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+
+    seconds = (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9;
+    fprintf(stderr, "%ld lines in %.3fs: %.0f lines/s, %.1f MB/s\n", lines,
+	    seconds, lines / seconds, bytes / seconds / 1e6);
+    return failed;
 }
@@ -0,0 +1,482 @@
+/* mask.c -- hands as 52-bit card masks, and a fast strength evaluator
+
+Every card has an index from 0 to 51: thirteen ranks (in the order of
+the ranks array in cards.c) for each suit (in the order of suits), so
+the 2 of clubs is 0 and the A of spades is 51. A set of cards is then
+just a CardMask with one bit per card:
+
+  Hand *hand = create_batch_hand("A of spades, A of clubs, 3 of hearts, ...");
+  CardMask m = hand_mask(hand);
+
+  mask_strength(m);          // strength key; bigger keys beat smaller ones
+  mask_ranking(m);           // index into ranking_data, e.g. 7 ("pair")
+  mask_category(m);          // the same, without working out the key
+
+Strength keys work for anything from one to seven cards (the best five
+are used). The ranking_data index lives in the top bits of the key, and
+below it the deciding ranks, highest first, one nibble each:
+
+  key = (8 - ranking) << 20 | r1 << 16 | r2 << 12 | r3 << 8 | r4 << 4 | r5
+
+where each r is a rank index plus one, so that a missing kicker (in
+hands of fewer than five cards) sorts below a 2.
+
+wild_strength does the same with wild cards: jokers, or whole ranks
+(deuces, say) that are wild. Five of a kind comes out on top, with
+9 << 20 in the key, so its ranking is FIVE_OF_A_KIND (-1): there's no
+room for it in ranking_data or the tables indexed like it, and
+strength_description is the way to name any key. With no wilds it is
+mask_strength; with some it goes down the rankings a branch at a time
+and is about a third slower (tools/perfcount's wild_strength/6+joker
+against mask_strength/7).
+
+*/
+
+#include "cards.h"
+#include <string.h>
+extern char *ranks[];
+extern char *suits[];
+extern ranking_datum ranking_data[];
+
+#define SUIT_RANKS(m, s) ((unsigned)((m) >> (13 * (s))) & 0x1fff)
+
+static int top_rank(unsigned m)
+{
+    return 31 - __builtin_clz(m);
+}
+
+/* Returns the rank of the high card of the best straight in a 13-bit
+   rank mask, or -1 if there isn't one. The ace is copied down below
+   the 2 so that it can play low.
+*/
+
+int straight_high(unsigned ranks)
+{
+    unsigned m = (ranks << 1) | (ranks >> 12);
+    m &= (m << 1) & (m << 2) & (m << 3) & (m << 4);
+    return m ? top_rank(m) - 1 : -1;
+}
+
+/* Per rank mask: the five highest ranks packed as in a strength key,
+   the number of ranks, and the straight (high card plus one, or 0).
+   About 48K all told, filled in before main runs.
+*/
+
+static unsigned top_ranks[8192];
+static unsigned char rank_counts[8192];
+static unsigned char straights[8192];
+
+/* The same as straights, with one to four wild cards to fill gaps */
+
+static unsigned char wild_straights[5][8192];
+
+__attribute__((constructor)) static void init_rank_tables(void)
+{
+    unsigned m, rest, window;
+    int i, r, w;
+    for (m = 0; m < 8192; m++) {
+	for (i = 0, rest = m; i < 5; i++) {
+	    top_ranks[m] <<= 4;
+	    if (rest) {
+		r = top_rank(rest);
+		top_ranks[m] |= r + 1;
+		rest &= ~(1u << r);
+	    }
+	}
+	rank_counts[m] = __builtin_popcount(m);
+	straights[m] = straight_high(m) + 1;
+    }
+    for (m = 0; m < 8192; m++) {
+	for (w = 1; w < 5; w++) {
+	    for (r = 12; r >= 3 && !wild_straights[w][m]; r--) {
+		window = r == 3 ? 0x100f : 0x1f << (r - 4);
+		if (rank_counts[m & window] + w >= 5) {
+		    wild_straights[w][m] = r + 1;
+		}
+	    }
+	}
+    }
+}
+
+/* What mask_strength looks things up in (wild_strength has
+   wild_straights as well) */
+
+size_t mask_table_bytes(void)
+{
+    return sizeof(top_ranks) + sizeof(rank_counts) + sizeof(straights);
+}
+
+/* Appends the n highest ranks in m to key, one nibble each. */
+
+static int kickers(int key, unsigned m, int n)
+{
+    return key << 4 * n | top_ranks[m] >> 4 * (5 - n);
+}
+
+/* The strength of a hand given as the rank masks of its clubs,
+   diamonds, hearts and spades, for callers that already have the
+   masks split up by suit (see board.c). */
+
+int suit_masks_strength(unsigned c, unsigned d, unsigned h, unsigned s)
+{
+    unsigned ranks = c | d | h | s;
+    unsigned four = c & d & h & s;
+    unsigned three = ((c & d) | (h & s)) & ((c & h) | (d & s));
+    unsigned two = (c & d) | (c & h) | (c & s) | (d & h) | (d & s) | (h & s);
+    unsigned flush = 0;
+    int t, p, high;
+
+    if (rank_counts[c] >= 5) flush = c;
+    if (rank_counts[d] >= 5) flush = d;
+    if (rank_counts[h] >= 5) flush = h;
+    if (rank_counts[s] >= 5) flush = s;
+
+    if (flush && (high = straights[flush])) {
+	return 8 << 20 | high << 16;
+    }
+    if (four) {
+	t = top_rank(four);
+	return kickers(7 << 4 | (t + 1), ranks & ~(1u << t), 1) << 12;
+    }
+    three &= ~four;
+    two &= ~three;
+    if (three && (two || (three & (three - 1)))) {
+	t = top_rank(three);
+	p = top_rank(two | (three & ~(1u << t)));
+	return (6 << 20) | (t + 1) << 16 | (p + 1) << 12;
+    }
+    if (flush) {
+	return kickers(5, flush, 5);
+    }
+    if ((high = straights[ranks])) {
+	return 4 << 20 | high << 16;
+    }
+    if (three) {
+	t = top_rank(three);
+	return kickers(3 << 4 | (t + 1), ranks & ~(1u << t), 2) << 8;
+    }
+    if (two & (two - 1)) {
+	t = top_rank(two);
+	p = top_rank(two & ~(1u << t));
+	return kickers(2 << 8 | (t + 1) << 4 | (p + 1),
+		       ranks & ~(1u << t) & ~(1u << p), 1) << 8;
+    }
+    if (two) {
+	p = top_rank(two);
+	return kickers(1 << 4 | (p + 1), ranks & ~(1u << p), 3) << 4;
+    }
+    return kickers(0, ranks, 5);
+}
+
+int mask_strength(CardMask m)
+{
+    return suit_masks_strength(SUIT_RANKS(m, 0), SUIT_RANKS(m, 1),
+			       SUIT_RANKS(m, 2), SUIT_RANKS(m, 3));
+}
+
+/* The ranks held by at least n cards, n being from 0 to 5 */
+
+#define AT_LEAST(n) ((n) <= 0 ? 0x1fff : (n) == 1 ? ranks : (n) == 2 ? two \
+		     : (n) == 3 ? three : (n) == 4 ? four : 0)
+
+/* The strength of m plus a number of jokers, with the cards of any of
+   the ranks in wild_ranks (bit 0 for the 2s) wild as well. Rather than
+   trying every card for every wild, it works down the rankings from
+   five of a kind, asking of each whether the wilds can make it, and
+   the best way if so: the wilds go on the rank with most cards, into
+   the gaps of a straight, and as the highest ranks missing from a
+   flush. Anything the wilds could make two ways up (a full house from
+   trips, say) is caught by the ranking above first. */
+
+int wild_strength(CardMask m, int wilds, unsigned wild_ranks)
+{
+    unsigned suit[4], ranks, two, three, four, wanted, f, flush, suited, left;
+    int i, w, t, p, high, key, best;
+
+    for (i = 0; i < 4; i++) {
+	suit[i] = SUIT_RANKS(m, i);
+    }
+    if (wild_ranks) {
+	for (i = 0; i < 4; i++) {
+	    wilds += rank_counts[suit[i] & wild_ranks];
+	    suit[i] &= ~wild_ranks;
+	}
+    }
+    if (!wilds) {
+	return suit_masks_strength(suit[0], suit[1], suit[2], suit[3]);
+    }
+    w = wilds < 5 ? wilds : 5;
+    ranks = suit[0] | suit[1] | suit[2] | suit[3];
+    four = suit[0] & suit[1] & suit[2] & suit[3];
+    three = ((suit[0] & suit[1]) | (suit[2] & suit[3]))
+	& ((suit[0] & suit[2]) | (suit[1] & suit[3]));
+    two = (suit[0] & suit[1]) | (suit[0] & suit[2]) | (suit[0] & suit[3])
+	| (suit[1] & suit[2]) | (suit[1] & suit[3]) | (suit[2] & suit[3]);
+
+    /* The suits the wilds can make a flush in, mostly none */
+    for (i = 0, suited = 0; i < 4; i++) {
+	suited |= (rank_counts[suit[i]] + w >= 5) << i;
+    }
+
+    if ((wanted = AT_LEAST(5 - w))) {
+	return 9 << 20 | (top_rank(wanted) + 1) << 16;
+    }
+    for (left = suited, high = 0; left; left &= left - 1) {
+	i = __builtin_ctz(left);
+	if (wild_straights[w][suit[i]] > high) {
+	    high = wild_straights[w][suit[i]];
+	}
+    }
+    if (high) {
+	return 8 << 20 | high << 16;
+    }
+    if ((wanted = AT_LEAST(4 - w))) {
+	t = top_rank(wanted);
+	return kickers(7 << 4 | (t + 1), ranks & ~(1u << t), 1) << 12;
+    }
+    /* Only one wild gets this far: two pair and it */
+    if (two & (two - 1)) {
+	t = top_rank(two);
+	p = top_rank(two & ~(1u << t));
+	return (6 << 20) | (t + 1) << 16 | (p + 1) << 12;
+    }
+    for (left = suited, best = 0; left; left &= left - 1) {
+	i = __builtin_ctz(left);
+	for (f = w, flush = suit[i]; f; f--) {
+	    flush |= 1u << top_rank(~flush & 0x1fff);
+	}
+	if ((key = kickers(5, flush, 5)) > best) {
+	    best = key;
+	}
+    }
+    if (best) {
+	return best;
+    }
+    if ((high = wild_straights[w][ranks])) {
+	return 4 << 20 | high << 16;
+    }
+    if ((wanted = AT_LEAST(3 - w))) {
+	t = top_rank(wanted);
+	return kickers(3 << 4 | (t + 1), ranks & ~(1u << t), 2) << 8;
+    }
+    /* One wild pairs the top card, and two with no cards at all are a
+       pair of aces; one on its own is an ace */
+    if ((wanted = AT_LEAST(2 - w))) {
+	p = top_rank(wanted);
+	return kickers(1 << 4 | (p + 1), ranks & ~(1u << p), 3) << 4;
+    }
+    return kickers(0, 1u << 12, 5);
+}
+
+int mask_ranking(CardMask m)
+{
+    return STRENGTH_RANKING(mask_strength(m));
+}
+
+/* "pair", say, for any strength key, wild_strength's included */
+
+char *strength_description(int key)
+{
+    int r = STRENGTH_RANKING(key);
+    return r == FIVE_OF_A_KIND ? "five of a kind" : ranking_data[r].ranking;
+}
+
+/* mask_ranking without working out any of the ranks that decide
+   between hands of one ranking, for up to seven cards. The ranks held
+   in two, three and four suits come from pairing the suits up, clubs
+   with diamonds and hearts with spades, and straights from the rank
+   table; each ranking the cards make then sets a bit, in ranking_data's
+   order, and the lowest one set is the answer. The only branches are
+   the flush checks, which are nearly always not taken. */
+
+int mask_category(CardMask m)
+{
+    unsigned c = SUIT_RANKS(m, 0), d = SUIT_RANKS(m, 1);
+    unsigned h = SUIT_RANKS(m, 2), s = SUIT_RANKS(m, 3);
+    unsigned both_low = c & d, both_high = h & s, low = c | d, high = h | s;
+    unsigned four = both_low & both_high;
+    unsigned three = ((both_low & high) | (both_high & low)) & ~four;
+    unsigned two = (both_low | both_high | (low & high)) & ~three & ~four;
+    unsigned flush = 0, found;
+
+    if (rank_counts[c] >= 5) flush = c;
+    if (rank_counts[d] >= 5) flush = d;
+    if (rank_counts[h] >= 5) flush = h;
+    if (rank_counts[s] >= 5) flush = s;
+    found = (straights[flush] != 0)
+	| (four != 0) << 1
+	| ((three != 0) & ((two | (three & (three - 1))) != 0)) << 2
+	| (flush != 0) << 3
+	| (straights[low | high] != 0) << 4
+	| (three != 0) << 5
+	| ((two & (two - 1)) != 0) << 6
+	| (two != 0) << 7
+	| 1 << 8;
+    return __builtin_ctz(found);
+}
+
+/* Adds the number of hands of each ranking to counts[], for histograms
+   of large numbers of hands. Two sets of counts, taking turns, keep
+   runs of one ranking from waiting on each other's increments. */
+
+void mask_category_counts(CardMask *masks, long n, long counts[RANKINGS_N])
+{
+    long even[RANKINGS_N] = { 0 }, odd[RANKINGS_N] = { 0 };
+    long i;
+    int r;
+
+    for (i = 0; i + 1 < n; i += 2) {
+	even[mask_category(masks[i])]++;
+	odd[mask_category(masks[i + 1])]++;
+    }
+    if (i < n) {
+	even[mask_category(masks[i])]++;
+    }
+    for (r = 0; r < RANKINGS_N; r++) {
+	counts[r] += even[r] + odd[r];
+    }
+}
+
+/* Evaluates a whole array in one go, for callers that gather work up
+   into batches. */
+
+void mask_strengths(CardMask *masks, int *keys, int n)
+{
+    int i;
+    for (i = 0; i < n; i++) {
+	keys[i] = mask_strength(masks[i]);
+    }
+}
+
+static int parse_rank(char **pp)
+{
+    char *p = *pp;
+    int r;
+    if (*p >= '2' && *p <= '9') {
+	r = *p - '2';
+    }
+    else if (*p == '1' && p[1] == '0') {
+	r = 8;
+	p++;
+    }
+    else {
+	for (r = 9; r < 13 && *ranks[r] != *p; r++)
+	    ;
+	if (r == 13) {
+	    return -1;
+	}
+    }
+    *pp = p + 1;
+    return r;
+}
+
+static int parse_suit(char **pp)
+{
+    static int lengths[] = { 5, 8, 6, 6 };
+    int s;
+    switch (**pp) {
+    case 'c': s = 0; break;
+    case 'd': s = 1; break;
+    case 'h': s = 2; break;
+    case 's': s = 3; break;
+    default: return -1;
+    }
+    if (strncmp(*pp, suits[s], lengths[s])) {
+	return -1;
+    }
+    *pp += lengths[s];
+    return s;
+}
+
+/* Reads cards in create_batch_hand's form ("3 of hearts, K of spades")
+   straight into a mask, without making any Cards. Reading stops at
+   the end of the string, a newline or a ';', where *end is left
+   pointing. Returns the number of cards, or -1 if the text doesn't
+   parse or has a card twice.
+*/
+
+int text_to_mask(char *text, CardMask *mp, char **end)
+{
+    char *p = text;
+    int n = 0, r, s;
+    CardMask card;
+
+    *mp = 0;
+    while (*p == ' ') p++;
+    while (*p && *p != '\n' && *p != '\r' && *p != ';') {
+	if (n && *p++ != ',') {
+	    n = -1;
+	    break;
+	}
+	while (*p == ' ') p++;
+	if ((r = parse_rank(&p)) < 0 || strncmp(p, " of ", 4)) {
+	    n = -1;
+	    break;
+	}
+	p += 4;
+	if ((s = parse_suit(&p)) < 0) {
+	    n = -1;
+	    break;
+	}
+	card = CARD_BIT(s * 13 + r);
+	if (*mp & card) {
+	    n = -1;
+	    break;
+	}
+	*mp |= card;
+	n++;
+	while (*p == ' ') p++;
+    }
+    if (n < 0) {
+	p += strcspn(p, "\n;");
+    }
+    if (end) {
+	*end = p;
+    }
+    return n;
+}
+
+/* The opposite of text_to_mask: writes the cards in create_batch_hand's
+   form, lowest index first, and returns the end of the string. The
+   buffer needs room for 17 bytes a card. */
+
+char *mask_to_text(char *buffer, CardMask m)
+{
+    char *p = buffer;
+    int i;
+    *p = '\0';
+    for (i = 0; i < 52; i++) {
+	if (m & CARD_BIT(i)) {
+	    p += sprintf(p, "%s%s of %s", p == buffer ? "" : ", ",
+			 ranks[i % 13], suits[i / 13]);
+	}
+    }
+    return p;
+}
+
+CardMask hand_mask(Hand *hand)
+{
+    int i, index;
+    CardMask m = 0;
+    for (i = 0; i < hand->len; i++) {
+	index = card_index(hand->cards[i]);
+	if (index >= 0) {
+	    m |= CARD_BIT(index);
+	}
+    }
+    return m;
+}
+
+/* Builds a Hand from a mask, lowest card index first. */
+
+Hand *mask_to_hand(CardMask m)
+{
+    Hand *hand = create_hand();
+    int i;
+    for (i = 0; i < 52; i++) {
+	if (m & CARD_BIT(i)) {
+	    add_card_to_hand(hand, ranks[i % 13], suits[i / 13]);
+	}
+    }
+    return hand;
+}
@@ -0,0 +1,155 @@
+/* montecarlo.c -- sampled heads-up equity that splits and merges exactly
+
+Example:
+
+  McResult r;
+  init_mc_result(&r, aces, kings, 0, 42, 0);   // key 42, from sample 0
+  monte_carlo(&r, 1000000);                    // samples 0 to 999,999
+  mc_equity(&r), mc_error(&r)                  // about 0.82, +/- 0.0004
+
+Sample i deals its board from philox(i, ..., key) alone (see rng.c),
+so a run over samples [a, b) and one over [b, c), merged with
+merge_mc_result, give exactly what one run over [a, c) would. The
+tallies are integers (a sample scores 2 for a win, 1 for a tie and 0
+for a loss) so merging doesn't depend on order, either.
+
+parse_shard turns "k/N" into shard k's share (counting from 0) of a
+run of samples, so N processes, or N machines, can each take one, and
+write_mc_result saves a result to carry on from or to merge later.
+
+*/
+
+#include "cards.h"
+#include <math.h>
+#include <string.h>
+
+#define DECK ((CARD_BIT(52)) - 1)
+
+void init_mc_result(McResult *rp, CardMask hole1, CardMask hole2,
+		    CardMask board, uint64_t key, uint64_t first)
+{
+    memset(rp, 0, sizeof(McResult));
+    memcpy(rp->magic, MC_MAGIC, 4);
+    rp->version = MC_VERSION;
+    rp->hole1 = hole1;
+    rp->hole2 = hole2;
+    rp->board = board;
+    rp->key = key;
+    rp->first = first;
+}
+
+/* Runs the next n samples after the ones already in the result */
+
+void monte_carlo(McResult *rp, uint64_t n)
+{
+    CardMask dead = rp->hole1 | rp->hole2 | rp->board, board;
+    unsigned char deck[52], shuffled[52], card;
+    uint32_t words[8];
+    uint64_t sample, end = rp->first + rp->count + n;
+    int size = 0, need = 5 - __builtin_popcountll(rp->board);
+    int i, j, key1, key2, score;
+
+    for (i = 0; i < 52; i++) {
+	if (!(dead & CARD_BIT(i))) {
+	    deck[size++] = i;
+	}
+    }
+    for (sample = rp->first + rp->count; sample < end; sample++) {
+	philox(sample, 0, rp->key, words);
+	if (need > 4) {
+	    philox(sample, 1, rp->key, words + 4);
+	}
+	/* The first few steps of a Fisher-Yates shuffle */
+	memcpy(shuffled, deck, size);
+	board = rp->board;
+	for (i = 0; i < need; i++) {
+	    j = i + random_below(words[i], size - i);
+	    card = shuffled[j];
+	    shuffled[j] = shuffled[i];
+	    shuffled[i] = card;
+	    board |= CARD_BIT(card);
+	}
+	key1 = mask_strength(rp->hole1 | board);
+	key2 = mask_strength(rp->hole2 | board);
+	score = (key1 > key2) ? 2 : (key1 == key2);
+	rp->wins += score == 2;
+	rp->ties += score == 1;
+	rp->losses += score == 0;
+	rp->sum += score;
+	rp->sum_squares += score * score;
+    }
+    rp->count += n;
+}
+
+/* Adds from into into, if they're the same problem and key and their
+   sample ranges meet end to end. Returns -1 (and leaves into alone)
+   if not. */
+
+int merge_mc_result(McResult *into, McResult *from)
+{
+    if (into->hole1 != from->hole1 || into->hole2 != from->hole2
+	|| into->board != from->board || into->key != from->key) {
+	return -1;
+    }
+    if (from->first + from->count == into->first) {
+	into->first = from->first;
+    }
+    else if (into->first + into->count != from->first) {
+	return -1;
+    }
+    into->count += from->count;
+    into->wins += from->wins;
+    into->ties += from->ties;
+    into->losses += from->losses;
+    into->sum += from->sum;
+    into->sum_squares += from->sum_squares;
+    return 0;
+}
+
+double mc_equity(McResult *rp)
+{
+    return rp->count ? rp->sum / 2.0 / rp->count : 0;
+}
+
+/* The standard error of mc_equity */
+
+double mc_error(McResult *rp)
+{
+    double mean, variance;
+    if (rp->count < 2) {
+	return 0;
+    }
+    mean = (double)rp->sum / rp->count;
+    variance = ((double)rp->sum_squares / rp->count - mean * mean)
+	* rp->count / (rp->count - 1);
+    return sqrt(variance / rp->count) / 2;
+}
+
+int write_mc_result(FILE *fp, McResult *rp)
+{
+    return fwrite(rp, sizeof(McResult), 1, fp) == 1 ? 0 : -1;
+}
+
+int read_mc_result(FILE *fp, McResult *rp)
+{
+    if (fread(rp, sizeof(McResult), 1, fp) != 1
+	|| memcmp(rp->magic, MC_MAGIC, 4) || rp->version != MC_VERSION) {
+	return -1;
+    }
+    return 0;
+}
+
+/* "k/N": the kth of N even shares of samples [0, total), counting k
+   from 0. Returns -1 for a spec that doesn't make sense. */
+
+int parse_shard(char *spec, uint64_t total, uint64_t *first, uint64_t *count)
+{
+    unsigned long k, n;
+    char extra;
+    if (sscanf(spec, "%lu/%lu%c", &k, &n, &extra) != 2 || n == 0 || k >= n) {
+	return -1;
+    }
+    *first = total / n * k + (k < total % n ? k : total % n);
+    *count = total / n + (k < total % n);
+    return 0;
+}
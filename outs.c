@@ -0,0 +1,119 @@
+/* outs.c -- which unseen cards improve a hand, and how likely they are
+
+Example:
+
+  CardMask hole = hand_mask(create_batch_hand("A of hearts, 9 of hearts"));
+  CardMask board = hand_mask(create_batch_hand("2 of hearts, K of hearts, 7 of clubs, J of spades"));
+  Outs outs;
+
+  count_outs(hole, board, 0, 1, &outs);   // 46 river cards
+
+  outs.ranking                            // 8 ("nothing") as things stand
+  outs.outs[3]                            // 9 river cards make a flush
+  outs.probability[3]                     // 9/46
+  outs.cards[3]                           // the mask of those 9 cards
+
+to_come is the number of board cards still to be dealt, 1 or 2. With
+two to come every two-card runout is counted instead, so outs[] and
+probability[] are "finishes as a flush by the river", and cards[] is
+left empty. Only runouts that improve the hand to a better ranking
+(in the ranking_data sense) are counted as outs.
+
+If opponent is non-zero it's taken as the opponent's hole cards. They
+come out of the deck, and clean[] counts the outs after which our hand
+still beats theirs on the same board.
+
+*/
+
+#include "cards.h"
+#include <string.h>
+
+#define DECK ((CARD_BIT(52)) - 1)
+
+/* Counts a runout, standing for n runouts in all, each of which leaves
+   the hand (and the opponent's) with the same strength. */
+
+static void tally(Outs *op, CardMask hand, CardMask theirs,
+		  CardMask runout, CardMask alike, int n)
+{
+    int key = mask_strength(hand | runout);
+    int r = STRENGTH_RANKING(key);
+    op->runouts += n;
+    if (r < op->ranking) {
+	op->outs[r] += n;
+	if (op->to_come == 1) {
+	    op->cards[r] |= alike;
+	}
+	if (theirs && key > mask_strength(theirs | runout)) {
+	    op->clean[r] += n;
+	}
+    }
+}
+
+/* A card of a suit that neither hand holds four of can't make a flush,
+   so on the river all such cards of one rank play the same. Each rank
+   is evaluated once for those, and the cards of the live flush suits
+   (at most a couple) one at a time.
+*/
+
+static void river_outs(Outs *op, CardMask hand, CardMask theirs, CardMask deck)
+{
+    CardMask live = 0, suit, alike, card;
+    int i, r;
+
+    for (i = 0; i < 4; i++) {
+	suit = ((CardMask)0x1fff) << (13 * i);
+	if (__builtin_popcountll(hand & suit) >= 4
+	    || __builtin_popcountll(theirs & suit) >= 4) {
+	    live |= suit;
+	}
+    }
+    for (r = 0; r < 13; r++) {
+	alike = deck & ~live & (CARD_BIT(r) | CARD_BIT(r + 13)
+				| CARD_BIT(r + 26) | CARD_BIT(r + 39));
+	if (alike) {
+	    tally(op, hand, theirs, alike & -alike, alike,
+		  __builtin_popcountll(alike));
+	}
+    }
+    for (deck &= live; deck; deck ^= card) {
+	card = deck & -deck;
+	tally(op, hand, theirs, card, card, 1);
+    }
+}
+
+int count_outs(CardMask hole, CardMask board, CardMask opponent,
+	       int to_come, Outs *op)
+{
+    CardMask hand = hole | board;
+    CardMask theirs = opponent ? opponent | board : 0;
+    CardMask deck = DECK & ~hand & ~opponent;
+    CardMask first, second, rest, later;
+    int i;
+
+    memset(op, 0, sizeof(Outs));
+    op->ranking = mask_ranking(hand);
+    op->to_come = to_come;
+    if (to_come < 1 || to_come > 2) {
+	return -1;
+    }
+
+    if (to_come == 1) {
+	river_outs(op, hand, theirs, deck);
+    }
+    else {
+	for (rest = deck; rest; rest ^= first) {
+	    first = rest & -rest;
+	    for (later = rest ^ first; later; later ^= second) {
+		second = later & -later;
+		tally(op, hand, theirs, first | second, 0, 1);
+	    }
+	}
+    }
+
+    for (i = 0; i < RANKINGS_N; i++) {
+	op->probability[i] = (double)op->outs[i] / op->runouts;
+	op->clean_probability[i] = (double)op->clean[i] / op->runouts;
+    }
+    return op->runouts;
+}
@@ -0,0 +1,150 @@
+/* reference.c -- a deliberately plain hand evaluator
+
+This is the yardstick the faster code gets checked against (see
+test/differ.c), so it's written to be obviously right rather than
+quick. A hand is boiled down to a value: six numbers that compare
+in order, the first being 8 minus the ranking_data index and the rest
+the ranks that decide ties, most important first (-1 where there
+aren't any). For example:
+
+  "3 of hearts, 4 of diamonds, 5 of spades, K of spades, 5 of clubs"
+
+is a pair (ranking 7) of 5s with K, 4, 3 to follow:
+
+  { 1, 3, 11, 2, 1, -1 }
+
+Hands of more than five cards are worth their best five-card subset,
+and ones of fewer what their cards make with -1 for the kickers they
+haven't got, as mask_strength scores them: A A 7 is a pair of aces
+with a 7, { 1, 12, 5, -1, -1, -1 }.
+
+*/
+
+#include "cards.h"
+#include <string.h>
+
+/* The value of five cards, or of fewer, which can't be a straight or
+   a flush */
+
+static void five_card_value(int rank[], int suit[], int cards, int value[])
+{
+    int counts[13] = { 0 };
+    int i, n, r, flush = cards == 5, straight = 0, pattern = 0, ranking;
+
+    for (i = 0; i < cards; i++) {
+	counts[rank[i]]++;
+	if (suit[i] != suit[0]) {
+	    flush = 0;
+	}
+    }
+
+    /* The ranks, biggest group first, then highest first */
+    for (i = 1; i < 6; i++) {
+	value[i] = -1;
+    }
+    for (n = 4, i = 1; n > 0; n--) {
+	for (r = 12; r >= 0; r--) {
+	    if (counts[r] == n) {
+		value[i++] = r;
+		pattern = pattern * 10 + n;
+	    }
+	}
+    }
+
+    if (pattern == 11111) {
+	if (value[1] - value[5] == 4) {
+	    straight = 1;
+	}
+	else if (value[1] == 12 && value[2] == 3) {
+	    straight = 1;    /* A 5 4 3 2: the ace plays low */
+	    value[1] = 3;
+	    value[2] = -1;
+	}
+	if (straight) {
+	    for (i = 2; i < 6; i++) {
+		value[i] = -1;
+	    }
+	}
+    }
+
+    /* A short hand ranks as if the missing cards were odd ones */
+    for (i = cards; i < 5; i++) {
+	pattern = pattern * 10 + 1;
+    }
+    if (straight && flush)     ranking = 0;
+    else if (pattern == 41)    ranking = 1;
+    else if (pattern == 32)    ranking = 2;
+    else if (flush)            ranking = 3;
+    else if (straight)         ranking = 4;
+    else if (pattern == 311)   ranking = 5;
+    else if (pattern == 221)   ranking = 6;
+    else if (pattern == 2111)  ranking = 7;
+    else                       ranking = 8;
+    value[0] = 8 - ranking;
+}
+
+static int compare_values(int v1[], int v2[])
+{
+    int i;
+    for (i = 0; i < 6; i++) {
+	if (v1[i] != v2[i]) {
+	    return v1[i] > v2[i] ? 1 : -1;
+	}
+    }
+    return 0;
+}
+
+/* Works for one to seven cards; the hand must have no unknown ranks
+   or suits. */
+
+void reference_value(Hand *hand, int value[])
+{
+    int rank[7], suit[7], r5[5], s5[5], v[6];
+    int i, j, k, pick, n = hand->len;
+
+    for (i = 0; i < n; i++) {
+	rank[i] = index_of_rank(hand->cards[i]->rank);
+	suit[i] = index_of_suit(hand->cards[i]->suit);
+    }
+    if (n < 5) {
+	five_card_value(rank, suit, n, value);
+	return;
+    }
+    for (i = 0; i < 6; i++) {
+	value[i] = -2;
+    }
+
+    /* Every way of picking five of the n cards */
+    for (pick = 0; pick < (1 << n); pick++) {
+	if (__builtin_popcount(pick) != 5) {
+	    continue;
+	}
+	for (j = 0, k = 0; j < n; j++) {
+	    if (pick & (1 << j)) {
+		r5[k] = rank[j];
+		s5[k++] = suit[j];
+	    }
+	}
+	five_card_value(r5, s5, 5, v);
+	if (compare_values(v, value) > 0) {
+	    memcpy(value, v, sizeof(v));
+	}
+    }
+}
+
+int reference_ranking(Hand *hand)
+{
+    int value[6];
+    reference_value(hand, value);
+    return 8 - value[0];
+}
+
+/* 1 if hand1 wins, -1 if hand2 does, 0 for a tie */
+
+int reference_compare(Hand *hand1, Hand *hand2)
+{
+    int v1[6], v2[6];
+    reference_value(hand1, v1);
+    reference_value(hand2, v2);
+    return compare_values(v1, v2);
+}
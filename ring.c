@@ -0,0 +1,87 @@
+/* ring.c -- a bounded ring buffer for passing work between threads
+
+Example:
+
+  Ring *ring = create_ring(64);
+
+  // in one thread
+  ring_put(ring, chunk);       // waits while the ring is full
+  ring_close(ring);            // no more to come
+
+  // in another
+  while ((chunk = ring_get(ring)))   // waits while it's empty; NULL
+      ...                            // once it's closed and drained
+
+  free_ring(ring);
+
+Items come out in the order they went in, so a chain of rings keeps
+a pipeline's output in input order.
+
+*/
+
+#include "cards.h"
+#include <pthread.h>
+
+struct ring {
+    void **slots;
+    int size, head, count, closed;
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty, not_full;
+};
+
+Ring *create_ring(int size)
+{
+    Ring *rp = malloc(sizeof(Ring));
+    rp->slots = malloc(size * sizeof(void *));
+    rp->size = size;
+    rp->head = rp->count = rp->closed = 0;
+    pthread_mutex_init(&rp->lock, NULL);
+    pthread_cond_init(&rp->not_empty, NULL);
+    pthread_cond_init(&rp->not_full, NULL);
+    return rp;
+}
+
+void free_ring(Ring *rp)
+{
+    pthread_mutex_destroy(&rp->lock);
+    pthread_cond_destroy(&rp->not_empty);
+    pthread_cond_destroy(&rp->not_full);
+    free(rp->slots);
+    free(rp);
+}
+
+void ring_put(Ring *rp, void *item)
+{
+    pthread_mutex_lock(&rp->lock);
+    while (rp->count == rp->size) {
+	pthread_cond_wait(&rp->not_full, &rp->lock);
+    }
+    rp->slots[(rp->head + rp->count++) % rp->size] = item;
+    pthread_cond_signal(&rp->not_empty);
+    pthread_mutex_unlock(&rp->lock);
+}
+
+void *ring_get(Ring *rp)
+{
+    void *item = NULL;
+    pthread_mutex_lock(&rp->lock);
+    while (rp->count == 0 && !rp->closed) {
+	pthread_cond_wait(&rp->not_empty, &rp->lock);
+    }
+    if (rp->count) {
+	item = rp->slots[rp->head];
+	rp->head = (rp->head + 1) % rp->size;
+	rp->count--;
+	pthread_cond_signal(&rp->not_full);
+    }
+    pthread_mutex_unlock(&rp->lock);
+    return item;
+}
+
+void ring_close(Ring *rp)
+{
+    pthread_mutex_lock(&rp->lock);
+    rp->closed = 1;
+    pthread_cond_broadcast(&rp->not_empty);
+    pthread_mutex_unlock(&rp->lock);
+}
@@ -0,0 +1,52 @@
+/* rng.c -- Philox4x32-10, a counter-based random number generator
+
+Philox turns a 128-bit counter and a 64-bit key into 128 random bits,
+with no state carried from one call to the next. So the numbers for
+sample 1,000,000 can be had without generating the 999,999 before it,
+and any stretch of samples comes out the same however a job is split
+up. (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3".)
+
+  uint32_t out[4];
+  philox(sample, block, key, out);     // the same inputs, the same out
+
+*/
+
+#include "cards.h"
+
+#define PHILOX_M0 0xd2511f53u
+#define PHILOX_M1 0xcd9e8d57u
+#define PHILOX_W0 0x9e3779b9u
+#define PHILOX_W1 0xbb67ae85u
+
+void philox(uint64_t counter, uint64_t block, uint64_t key, uint32_t out[4])
+{
+    uint32_t c0 = counter, c1 = counter >> 32, c2 = block, c3 = block >> 32;
+    uint32_t k0 = key, k1 = key >> 32, t0, t1;
+    uint64_t p0, p1;
+    int round;
+
+    for (round = 0; round < 10; round++) {
+	p0 = (uint64_t)PHILOX_M0 * c0;
+	p1 = (uint64_t)PHILOX_M1 * c2;
+	t0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+	t1 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+	c1 = (uint32_t)p1;
+	c3 = (uint32_t)p0;
+	c0 = t0;
+	c2 = t1;
+	k0 += PHILOX_W0;
+	k1 += PHILOX_W1;
+    }
+    out[0] = c0;
+    out[1] = c1;
+    out[2] = c2;
+    out[3] = c3;
+}
+
+/* A number from 0 to n - 1, from one random word (by multiplying
+   rather than with %, which is slower and no less biased) */
+
+int random_below(uint32_t word, int n)
+{
+    return ((uint64_t)word * n) >> 32;
+}
@@ -0,0 +1,257 @@
+/* sampling.c -- equity estimates that need fewer runouts than plain Monte Carlo
+
+Example:
+
+  Estimate e;
+  estimate_equity(hole1, hole2, flop, SAMPLE_STRATIFIED, 2000, 42, &e);
+  e.equity, e.error           // the estimate and its standard error
+  e.low, e.high               // a 95% confidence interval
+  e.evaluations               // runouts actually dealt
+
+The modes, all dealing from the same deck of live cards, kept sorted
+by rank so that a uniform number u picks a low card when small and a
+high one when large:
+
+  SAMPLE_PLAIN        independent runouts, error about 1/sqrt(n)
+  SAMPLE_STRATIFIED   the first card to come (the turn, from a flop)
+                      is every live card in turn, n / L runouts each,
+                      and within each of those the second card (the
+                      river) is spread evenly over the deck, one
+                      random offset for the lot. Only the rest of the
+                      runout is left to chance; with one card to come
+                      it's exact. The error is worked out as if the
+                      second card were random, so it's on the high
+                      side.
+  SAMPLE_ANTITHETIC   runouts in pairs, the second dealt from 1 - u
+                      wherever the first had u: low cards for high.
+                      The pair's scores tend to pull opposite ways.
+  SAMPLE_QUASI        a Halton sequence (one prime base per card to
+                      come) in place of random numbers, in 16 copies
+                      each shifted at random, so that the spread of
+                      the 16 gives the error.
+
+Each works out its error its own way, from the strata, the pairs or
+the copies, since the plain formula doesn't hold for them. tools/
+mcbench.c compares how many runouts each needs for an error target.
+
+*/
+
+#include "cards.h"
+#include <math.h>
+#include <string.h>
+
+#define DECK ((CARD_BIT(52)) - 1)
+#define QUASI_COPIES 16
+
+typedef struct {
+    CardMask hole1, hole2, board;
+    int need, live;
+    unsigned char deck[52];
+} Spot;
+
+/* The live cards, lowest rank first */
+
+static void set_up(Spot *sp, CardMask hole1, CardMask hole2, CardMask board)
+{
+    CardMask dead = hole1 | hole2 | board;
+    int rank, suit;
+
+    sp->hole1 = hole1;
+    sp->hole2 = hole2;
+    sp->board = board;
+    sp->need = 5 - __builtin_popcountll(board);
+    sp->live = 0;
+    for (rank = 0; rank < 13; rank++) {
+	for (suit = 0; suit < 4; suit++) {
+	    if (!(dead & CARD_BIT(suit * 13 + rank))) {
+		sp->deck[sp->live++] = suit * 13 + rank;
+	    }
+	}
+    }
+}
+
+/* 2 for a win, 1 a tie, 0 a loss */
+
+static int score(Spot *sp, CardMask runout)
+{
+    int key1 = mask_strength(sp->hole1 | sp->board | runout);
+    int key2 = mask_strength(sp->hole2 | sp->board | runout);
+    return (key1 > key2) ? 2 : (key1 == key2);
+}
+
+/* Deals need - skip cards from uniform numbers u, each choosing from
+   what's left of the deck in order, so the choice rises with u */
+
+static CardMask deal(Spot *sp, double *u, int skip, unsigned char *deck, int left)
+{
+    unsigned char cards[52];
+    CardMask runout = 0;
+    int i, j;
+
+    memcpy(cards, deck, left);
+    for (i = 0; i < sp->need - skip; i++) {
+	j = u[i] * (left - i);
+	runout |= CARD_BIT(cards[j]);
+	memmove(cards + j, cards + j + 1, left - i - j - 1);
+    }
+    return runout;
+}
+
+static void uniforms(uint64_t counter, uint64_t key, double *u, int n)
+{
+    uint32_t words[8];
+    int i;
+
+    philox(counter, 0, key, words);
+    if (n > 4) {
+	philox(counter, 1, key, words + 4);
+    }
+    for (i = 0; i < n; i++) {
+	u[i] = words[i] / 4294967296.0;
+    }
+}
+
+/* The mean and standard error of n values given their sum and sum of
+   squares */
+
+static void summarize(double sum, double squares, long n, double t, Estimate *ep)
+{
+    double variance = n > 1 ? (squares - sum * sum / n) / (n - 1) : 0;
+
+    ep->equity = n ? sum / n : 0;
+    ep->error = n ? sqrt((variance > 0 ? variance : 0) / n) : 0;
+    ep->low = ep->equity - t * ep->error;
+    ep->high = ep->equity + t * ep->error;
+}
+
+static void plain(Spot *sp, long n, uint64_t key, Estimate *ep)
+{
+    double u[5], y, sum = 0, squares = 0;
+    long i;
+
+    for (i = 0; i < n; i++) {
+	uniforms(i, key, u, sp->need);
+	y = score(sp, deal(sp, u, 0, sp->deck, sp->live)) / 2.0;
+	sum += y;
+	squares += y * y;
+    }
+    summarize(sum, squares, n, 1.96, ep);
+    ep->evaluations = n;
+}
+
+static void stratified(Spot *sp, long n, uint64_t key, Estimate *ep)
+{
+    unsigned char rest[52];
+    double u[5], offset[1], y, sum, squares, total = 0, variance = 0;
+    long each = sp->need == 1 ? 1 : n / sp->live > 2 ? n / sp->live : 2;
+    long i, counter = 0;
+    int h;
+
+    for (h = 0; h < sp->live; h++) {
+	memcpy(rest, sp->deck, h);
+	memcpy(rest + h, sp->deck + h + 1, sp->live - h - 1);
+	uniforms(counter++, key, offset, 1);
+	sum = squares = 0;
+	for (i = 0; i < each; i++) {
+	    uniforms(counter++, key, u, sp->need - 1);
+	    u[0] = (i + offset[0]) / each;
+	    y = score(sp, CARD_BIT(sp->deck[h]) | deal(sp, u, 1, rest, sp->live - 1)) / 2.0;
+	    sum += y;
+	    squares += y * y;
+	}
+	total += sum / each;
+	if (each > 1) {
+	    variance += (squares - sum * sum / each) / (each - 1) / each;
+	}
+    }
+    ep->equity = total / sp->live;
+    ep->error = sqrt(variance) / sp->live;
+    ep->low = ep->equity - 1.96 * ep->error;
+    ep->high = ep->equity + 1.96 * ep->error;
+    ep->evaluations = each * sp->live;
+}
+
+static void antithetic(Spot *sp, long n, uint64_t key, Estimate *ep)
+{
+    double u[5], mirror[5], y, sum = 0, squares = 0;
+    long i, pairs = n / 2 > 1 ? n / 2 : 1;
+    int j;
+
+    for (i = 0; i < pairs; i++) {
+	uniforms(i, key, u, sp->need);
+	for (j = 0; j < sp->need; j++) {
+	    mirror[j] = 1 - u[j] - 1 / 4294967296.0;
+	}
+	y = (score(sp, deal(sp, u, 0, sp->deck, sp->live))
+	     + score(sp, deal(sp, mirror, 0, sp->deck, sp->live))) / 4.0;
+	sum += y;
+	squares += y * y;
+    }
+    summarize(sum, squares, pairs, 1.96, ep);
+    ep->evaluations = 2 * pairs;
+}
+
+/* The digits of i in base b, reversed after the point */
+
+static double radical_inverse(long i, int b)
+{
+    double x = 0, place = 1.0 / b;
+    for (; i; i /= b, place /= b) {
+	x += (i % b) * place;
+    }
+    return x;
+}
+
+static void quasi(Spot *sp, long n, uint64_t key, Estimate *ep)
+{
+    static int bases[5] = { 2, 3, 5, 7, 11 };
+    double shift[5], u[5], mean, sum = 0, squares = 0;
+    long i, each = n / QUASI_COPIES > 1 ? n / QUASI_COPIES : 1;
+    int copy, j;
+
+    for (copy = 0; copy < QUASI_COPIES; copy++) {
+	uniforms(copy, key, shift, sp->need);
+	mean = 0;
+	for (i = 0; i < each; i++) {
+	    for (j = 0; j < sp->need; j++) {
+		u[j] = radical_inverse(i + 1, bases[j]) + shift[j];
+		u[j] -= u[j] >= 1;
+	    }
+	    mean += score(sp, deal(sp, u, 0, sp->deck, sp->live)) / 2.0;
+	}
+	mean /= each;
+	sum += mean;
+	squares += mean * mean;
+    }
+    /* 2.13: Student's t for 15 degrees of freedom */
+    summarize(sum, squares, QUASI_COPIES, 2.13, ep);
+    ep->evaluations = each * QUASI_COPIES;
+}
+
+/* Estimates hole1's equity against hole2 (wins plus half the ties)
+   from about n runouts of the board. Returns -1 for a mode it doesn't
+   know or cards that clash. */
+
+int estimate_equity(CardMask hole1, CardMask hole2, CardMask board, int mode,
+		    long n, uint64_t key, Estimate *ep)
+{
+    Spot spot;
+
+    if ((hole1 & hole2) || ((hole1 | hole2) & board) || __builtin_popcountll(board) > 5) {
+	return -1;
+    }
+    set_up(&spot, hole1, hole2, board);
+    if (spot.need == 0) {
+	summarize(score(&spot, 0) / 2.0, 0, 1, 0, ep);
+	ep->evaluations = 1;
+	return 0;
+    }
+    switch (mode) {
+    case SAMPLE_PLAIN: plain(&spot, n, key, ep); break;
+    case SAMPLE_STRATIFIED: stratified(&spot, n, key, ep); break;
+    case SAMPLE_ANTITHETIC: antithetic(&spot, n, key, ep); break;
+    case SAMPLE_QUASI: quasi(&spot, n, key, ep); break;
+    default: return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,223 @@
+/* showdown.c -- showdowns between up to ten seats, and a table simulator
+
+Example:
+
+  CardMask holes[SEATS_MAX] = { ... };   // 0 for a seat that's folded
+  int keys[SEATS_MAX];
+  unsigned winners;
+  showdown(holes, 6, board, keys, &winners);  // bit i set if seat i wins
+
+  long bets[SEATS_MAX] = { ... }, won[SEATS_MAX];
+  split_pots(keys, bets, 6, won);          // main and side pots paid out
+
+showdown splits the board into per-suit rank masks once and ORs each
+seat's two cards in, so it's one evaluation a seat and one pass to
+find the best key and everyone who has it, however many seats there
+are. split_pots pays each layer of the pot (up to each all-in amount)
+to the best hand among the seats that put that much in, splitting
+ties evenly, with odd chips going to the winners nearest seat 0.
+
+simulate_table deals whole hands to a table of seats, from the same
+counter-based numbers as montecarlo.c (so runs split and merge
+exactly), and counts, for each of the 169 starting hands, how often
+it was dealt, won, split, and its share of the pots in 1/SHARE_UNIT
+pots (2520 divides evenly by any number of winners up to ten).
+
+*/
+
+#include "cards.h"
+#include <string.h>
+
+int showdown(CardMask *holes, int seats, CardMask board, int *keys, unsigned *winners)
+{
+    unsigned suit[4], with[4];
+    int best = -1, key, i, s;
+
+    for (s = 0; s < 4; s++) {
+	suit[s] = (board >> (13 * s)) & 0x1fff;
+    }
+    *winners = 0;
+    for (i = 0; i < seats; i++) {
+	if (!holes[i]) {
+	    key = -1;
+	}
+	else {
+	    for (s = 0; s < 4; s++) {
+		with[s] = suit[s] | ((holes[i] >> (13 * s)) & 0x1fff);
+	    }
+	    key = suit_masks_strength(with[0], with[1], with[2], with[3]);
+	}
+	if (keys) {
+	    keys[i] = key;
+	}
+	if (key > best) {
+	    best = key;
+	    *winners = 1u << i;
+	}
+	else if (key == best && key >= 0) {
+	    *winners |= 1u << i;
+	}
+    }
+    return best;
+}
+
+/* Pays out what the seats bet (bets[i], with keys[i] from showdown, or
+   -1 for a seat that folded) into won[i]. Folded seats' chips go to
+   the pots they reached but they can't win them. Returns what's left
+   over, which is only anything if a layer had no one to win it. */
+
+long split_pots(int *keys, long *bets, int seats, long *won)
+{
+    long level = 0, next, pot, share, odd, unclaimed = 0;
+    unsigned winners;
+    int best, i, n;
+
+    memset(won, 0, seats * sizeof(long));
+    for (;;) {
+	/* The next all-in amount up */
+	next = -1;
+	for (i = 0; i < seats; i++) {
+	    if (bets[i] > level && (next < 0 || bets[i] < next)) {
+		next = bets[i];
+	    }
+	}
+	if (next < 0) {
+	    return unclaimed;
+	}
+	pot = 0;
+	best = -1;
+	winners = 0;
+	for (i = 0; i < seats; i++) {
+	    if (bets[i] > level) {
+		pot += (bets[i] < next ? bets[i] : next) - level;
+		if (bets[i] >= next && keys[i] > best) {
+		    best = keys[i];
+		    winners = 1u << i;
+		}
+		else if (bets[i] >= next && keys[i] == best && best >= 0) {
+		    winners |= 1u << i;
+		}
+	    }
+	}
+	if (!winners || best < 0) {
+	    unclaimed += pot;
+	}
+	else {
+	    n = __builtin_popcount(winners);
+	    share = pot / n;
+	    odd = pot % n;
+	    for (i = 0; i < seats; i++) {
+		if (winners & (1u << i)) {
+		    won[i] += share + (odd-- > 0);
+		}
+	    }
+	}
+	level = next;
+    }
+}
+
+/* 0 to 168, on a 13 by 13 grid: pairs on the diagonal, suited hands
+   above it (high rank first) and offsuit ones below */
+
+int starting_hand(CardMask hole)
+{
+    int a = __builtin_ctzll(hole), b = 63 - __builtin_clzll(hole);
+    int high = a % 13 > b % 13 ? a % 13 : b % 13, low = a % 13 + b % 13 - high;
+    return a / 13 == b / 13 ? low * 13 + high : high * 13 + low;
+}
+
+/* "AA", "AKs", "72o" */
+
+char *starting_hand_name(char *buffer, int hand)
+{
+    static char names[] = "23456789TJQKA";
+    int row = hand / 13, column = hand % 13;
+
+    buffer[0] = names[row > column ? row : column];
+    buffer[1] = names[row > column ? column : row];
+    buffer[2] = row == column ? '\0' : row < column ? 's' : 'o';
+    buffer[3] = '\0';
+    return buffer;
+}
+
+void init_table_stats(TableStats *sp, int seats, uint64_t key, uint64_t first)
+{
+    memset(sp, 0, sizeof(TableStats));
+    sp->seats = seats;
+    sp->key = key;
+    sp->first = first;
+}
+
+/* Deals the next n hands after the ones already counted. Hand i's
+   cards come from philox(i, 0..6, key) alone. */
+
+void simulate_table(TableStats *sp, uint64_t n)
+{
+    CardMask holes[SEATS_MAX], board;
+    unsigned char deck[52], card;
+    uint32_t words[28];
+    uint64_t hand, end = sp->first + sp->hands + n;
+    unsigned winners;
+    int need = 2 * sp->seats + 5, i, j, share, kind;
+
+    for (hand = sp->first + sp->hands; hand < end; hand++) {
+	for (i = 0; i < need; i += 4) {
+	    philox(hand, i / 4, sp->key, words + i);
+	}
+	/* The first few steps of a Fisher-Yates shuffle */
+	for (i = 0; i < 52; i++) {
+	    deck[i] = i;
+	}
+	for (i = 0; i < need; i++) {
+	    j = i + random_below(words[i], 52 - i);
+	    card = deck[j];
+	    deck[j] = deck[i];
+	    deck[i] = card;
+	}
+	board = 0;
+	for (i = 0; i < 5; i++) {
+	    board |= CARD_BIT(deck[2 * sp->seats + i]);
+	}
+	for (i = 0; i < sp->seats; i++) {
+	    holes[i] = CARD_BIT(deck[2 * i]) | CARD_BIT(deck[2 * i + 1]);
+	}
+	showdown(holes, sp->seats, board, NULL, &winners);
+	share = SHARE_UNIT / __builtin_popcount(winners);
+	for (i = 0; i < sp->seats; i++) {
+	    kind = starting_hand(holes[i]);
+	    sp->dealt[kind]++;
+	    if (winners & (1u << i)) {
+		sp->wins[kind] += winners == 1u << i;
+		sp->ties[kind] += winners != 1u << i;
+		sp->shares[kind] += share;
+	    }
+	}
+    }
+    sp->hands += n;
+}
+
+/* As merge_mc_result: the same table and key, and hand ranges that
+   meet end to end, or -1 */
+
+int merge_table_stats(TableStats *into, TableStats *from)
+{
+    int i;
+
+    if (into->seats != from->seats || into->key != from->key) {
+	return -1;
+    }
+    if (from->first + from->hands == into->first) {
+	into->first = from->first;
+    }
+    else if (into->first + into->hands != from->first) {
+	return -1;
+    }
+    into->hands += from->hands;
+    for (i = 0; i < STARTING_HANDS; i++) {
+	into->dealt[i] += from->dealt[i];
+	into->wins[i] += from->wins[i];
+	into->ties[i] += from->ties[i];
+	into->shares[i] += from->shares[i];
+    }
+    return 0;
+}
@@ -0,0 +1,449 @@
+/* strength.c -- precomputed hand strength and potential for every board
+
+Example:
+
+  StrengthTable *tp = open_strength_table("strengths.bin", 0);
+  strength_lookup(tp, hole, flop, &ehs, &ehs2);  // E[HS] and E[HS^2]
+  close_strength_table(tp);
+
+A hand's strength (HS) on a river is its share of showdowns against
+one opponent holding any two other cards (see board_strengths). On
+the flop or the turn, ehs is its expected value over the cards to
+come, and ehs2 the expected square, which is higher for drawing hands
+whose strength swings (see street_strengths).
+
+Suits are interchangeable, so the table keeps only canonical boards:
+the smallest mask among a board's 24 suit relabellings. That's 1,755
+flops, 16,432 turns and 134,459 rivers. Each street in the file has,
+in order:
+
+  int32_t index[C(52, k)]        every board by colex number: the slot
+                                 of its canonical board << 5, and the
+                                 relabelling (0 to 23) that makes it
+  CardMask boards[slots]         the canonical boards
+  uint8_t done[slots]            which slots have been worked out
+  uint16_t values[slots][1326][2] ehs and ehs2 times 65535, by the
+                                 relabelled hole's combo_index
+
+each part padded to 8 bytes, after a StrengthFileHeader giving the
+slot counts and where each street starts. So a lookup is the board's
+colex number, a table read, a relabelling of the hole and one more
+read. The river, at 700MB, is optional; its values are quick to make
+on the spot with rank_board.
+
+The table is built (see tools/strengths.c) by create_strength_table,
+store_strengths for each slot, and checkpoint_strength_table now and
+then, which flushes the values and only then marks their slots done
+in the file, so a run that's stopped can carry on where it left off.
+
+*/
+
+#include "cards.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define DECK ((CARD_BIT(52)) - 1)
+#define ALIGN(n) (((n) + 7) & ~(size_t)7)
+
+struct strength_table {
+    int fd;
+    int writable;
+    unsigned char *map;
+    size_t size;
+    StrengthFileHeader *header;
+    int32_t *index[3];
+    CardMask *boards[3];
+    unsigned char *done[3];
+    unsigned char *finished[3];
+    uint16_t *values[3];
+    pthread_mutex_t lock;
+};
+
+static int binomial[53][8];
+static int perms[24][4];
+
+static void __attribute__((constructor)) make_strength_tables(void)
+{
+    int n, k, a, b, c, d, p = 0;
+
+    for (n = 0; n <= 52; n++) {
+	binomial[n][0] = 1;
+	for (k = 1; k < 8; k++) {
+	    binomial[n][k] = n ? binomial[n - 1][k - 1] + binomial[n - 1][k] : 0;
+	}
+    }
+    for (a = 0; a < 4; a++) {
+	for (b = 0; b < 4; b++) {
+	    for (c = 0; c < 4; c++) {
+		d = 6 - a - b - c;
+		if (a != b && a != c && b != c && d >= 0 && d < 4
+		    && d != a && d != b && d != c) {
+		    perms[p][0] = a;
+		    perms[p][1] = b;
+		    perms[p][2] = c;
+		    perms[p++][3] = d;
+		}
+	    }
+	}
+    }
+}
+
+/* A set's place among all sets of as many cards (up to seven),
+   counting up by mask */
+
+long colex_index(CardMask m, int *cards)
+{
+    long index = 0;
+    int k = 0;
+    while (m) {
+	index += binomial[__builtin_ctzll(m)][++k];
+	m &= m - 1;
+    }
+    *cards = k;
+    return index;
+}
+
+/* m with suit s relabelled as perms[perm][s] */
+
+CardMask permute_suits(CardMask m, int perm)
+{
+    CardMask out = 0;
+    int s;
+    for (s = 0; s < 4; s++) {
+	out |= ((m >> (13 * s)) & 0x1fff) << (13 * perms[perm][s]);
+    }
+    return out;
+}
+
+/* The smallest relabelling of board, and which one it was */
+
+CardMask canonical_board(CardMask board, int *perm)
+{
+    CardMask best = board, m;
+    int p;
+    *perm = 0;
+    for (p = 1; p < 24; p++) {
+	if ((m = permute_suits(board, p)) < best) {
+	    best = m;
+	    *perm = p;
+	}
+    }
+    return best;
+}
+
+static void add_river(CardMask board, BoardRanking *bp, double *hs,
+		      double *ehs, double *ehs2, int *runouts)
+{
+    int i, combo;
+
+    rank_board(board, 0, bp);
+    board_strengths(bp, hs);
+    for (i = 0; i < bp->n; i++) {
+	combo = combo_index(bp->combos[i]);
+	ehs[combo] += hs[combo];
+	ehs2[combo] += hs[combo] * hs[combo];
+	runouts[combo]++;
+    }
+}
+
+/* E[HS] and E[HS^2] for every combo on a flop, turn or river, over
+   every card or two still to come. Both are indexed by combo_index;
+   combos that clash with the board get 0. */
+
+void street_strengths(CardMask board, double *ehs, double *ehs2)
+{
+    BoardRanking *bp = malloc(sizeof(BoardRanking));
+    CardMask live = DECK & ~board;
+    double hs[COMBOS_N];
+    int runouts[COMBOS_N], cards = __builtin_popcountll(board), i, t, r;
+
+    memset(runouts, 0, sizeof(runouts));
+    memset(ehs, 0, COMBOS_N * sizeof(double));
+    memset(ehs2, 0, COMBOS_N * sizeof(double));
+    if (cards == 5) {
+	add_river(board, bp, hs, ehs, ehs2, runouts);
+    }
+    for (t = 0; cards < 5 && t < 52; t++) {
+	if (!(live & CARD_BIT(t))) {
+	    continue;
+	}
+	if (cards == 4) {
+	    add_river(board | CARD_BIT(t), bp, hs, ehs, ehs2, runouts);
+	    continue;
+	}
+	for (r = t + 1; r < 52; r++) {
+	    if (live & CARD_BIT(r)) {
+		add_river(board | CARD_BIT(t) | CARD_BIT(r), bp, hs, ehs, ehs2, runouts);
+	    }
+	}
+    }
+    for (i = 0; i < COMBOS_N; i++) {
+	if (runouts[i]) {
+	    ehs[i] /= runouts[i];
+	    ehs2[i] /= runouts[i];
+	}
+    }
+    free(bp);
+}
+
+/* Points the table's arrays into its map, by the header */
+
+static void lay_out(StrengthTable *tp)
+{
+    unsigned char *p;
+    int street, n;
+
+    tp->header = (StrengthFileHeader *)tp->map;
+    for (street = 0; street < 3; street++) {
+	if (!(tp->header->streets & (1 << street))) {
+	    continue;
+	}
+	n = tp->header->boards[street];
+	p = tp->map + tp->header->offset[street];
+	tp->index[street] = (int32_t *)p;
+	p += ALIGN(binomial[52][street + 3] * sizeof(int32_t));
+	tp->boards[street] = (CardMask *)p;
+	p += ALIGN(n * sizeof(CardMask));
+	tp->done[street] = p;
+	p += ALIGN(n);
+	tp->values[street] = (uint16_t *)p;
+    }
+}
+
+static size_t street_bytes(int street, int n)
+{
+    return ALIGN(binomial[52][street + 3] * sizeof(int32_t))
+	+ ALIGN(n * sizeof(CardMask)) + ALIGN(n)
+	+ (size_t)n * COMBOS_N * 2 * sizeof(uint16_t);
+}
+
+static StrengthTable *map_table(int fd, size_t size, int writable)
+{
+    StrengthTable *tp = calloc(1, sizeof(StrengthTable));
+    int street;
+
+    tp->fd = fd;
+    tp->size = size;
+    tp->writable = writable;
+    tp->map = mmap(NULL, size, writable ? PROT_READ | PROT_WRITE : PROT_READ,
+		   MAP_SHARED, fd, 0);
+    if (tp->map == MAP_FAILED) {
+	close(fd);
+	free(tp);
+	return NULL;
+    }
+    pthread_mutex_init(&tp->lock, NULL);
+    lay_out(tp);
+    if (writable) {
+	for (street = 0; street < 3; street++) {
+	    if (tp->done[street]) {
+		tp->finished[street] = malloc(tp->header->boards[street]);
+		memcpy(tp->finished[street], tp->done[street], tp->header->boards[street]);
+	    }
+	}
+    }
+    return tp;
+}
+
+/* A new, empty table for the streets given (STRENGTH_FLOP and so on),
+   with its boards and index filled in. NULL if the file can't be
+   made. */
+
+StrengthTable *create_strength_table(char *path, int streets)
+{
+    StrengthFileHeader header = { STRENGTH_MAGIC, STRENGTH_VERSION, streets, 0 };
+    int32_t *index[3] = { NULL };
+    CardMask *boards[3] = { NULL }, m, low;
+    StrengthTable *tp;
+    size_t size = ALIGN(sizeof(header));
+    long i, all;
+    int street, perm, k, n, fd;
+
+    for (street = 0; street < 3; street++) {
+	if (!(streets & (1 << street))) {
+	    continue;
+	}
+	all = binomial[52][street + 3];
+	index[street] = malloc(all * sizeof(int32_t));
+	boards[street] = malloc(all * sizeof(CardMask));
+	n = 0;
+	/* Every board in colex order: each canonical board comes before
+	   the others it stands for, being the smallest of them */
+	for (m = CARD_BIT(street + 3) - 1, i = 0; m <= DECK; i++) {
+	    CardMask canonical = canonical_board(m, &perm);
+	    if (canonical == m) {
+		boards[street][n] = m;
+		index[street][i] = n++ << 5;
+	    }
+	    else {
+		index[street][i] = (index[street][colex_index(canonical, &k)] & ~31) | perm;
+	    }
+	    low = m & -m;
+	    m = ((((m + low) ^ m) >> 2) / low) | (m + low);
+	}
+	header.boards[street] = n;
+	header.offset[street] = size;
+	size += street_bytes(street, n);
+    }
+
+    if ((fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0
+	|| ftruncate(fd, size) < 0) {
+	if (fd >= 0) {
+	    close(fd);
+	}
+	tp = NULL;
+    }
+    else {
+	pwrite(fd, &header, sizeof(header), 0);
+	tp = map_table(fd, size, 1);
+    }
+    for (street = 0; street < 3; street++) {
+	if (tp && index[street]) {
+	    memcpy(tp->index[street], index[street],
+		   binomial[52][street + 3] * sizeof(int32_t));
+	    memcpy(tp->boards[street], boards[street],
+		   header.boards[street] * sizeof(CardMask));
+	}
+	free(index[street]);
+	free(boards[street]);
+    }
+    return tp;
+}
+
+/* Whether every street the header lists lies inside a file of size
+   bytes, so that a table cut short doesn't map and then fault */
+
+static int layout_fits(StrengthFileHeader *hp, size_t size)
+{
+    int street;
+
+    for (street = 0; street < 3; street++) {
+	if (!(hp->streets & (1 << street))) {
+	    continue;
+	}
+	if (hp->boards[street] > binomial[52][street + 3]
+	    || hp->offset[street] < ALIGN(sizeof(StrengthFileHeader))
+	    || hp->offset[street] > size
+	    || street_bytes(street, hp->boards[street]) > size - hp->offset[street]) {
+	    return 0;
+	}
+    }
+    return 1;
+}
+
+StrengthTable *open_strength_table(char *path, int writable)
+{
+    StrengthFileHeader header;
+    struct stat st;
+    int fd = open(path, writable ? O_RDWR : O_RDONLY);
+
+    if (fd < 0) {
+	return NULL;
+    }
+    if (fstat(fd, &st) < 0 || pread(fd, &header, sizeof(header), 0) != sizeof(header)
+	|| memcmp(header.magic, STRENGTH_MAGIC, 4) || header.version != STRENGTH_VERSION
+	|| !layout_fits(&header, st.st_size)) {
+	close(fd);
+	return NULL;
+    }
+    return map_table(fd, st.st_size, writable);
+}
+
+/* The number of canonical boards on a street (0 for the flop, 1 the
+   turn, 2 the river), or 0 if the table hasn't got it */
+
+int strength_table_boards(StrengthTable *tp, int street)
+{
+    return (tp->header->streets & (1 << street)) ? tp->header->boards[street] : 0;
+}
+
+CardMask strength_table_board(StrengthTable *tp, int street, int slot)
+{
+    return tp->boards[street][slot];
+}
+
+int strength_slot_done(StrengthTable *tp, int street, int slot)
+{
+    return tp->writable ? tp->finished[street][slot] : tp->done[street][slot];
+}
+
+/* Saves a slot's values, from street_strengths on its board. Threads
+   can store different slots at once. */
+
+void store_strengths(StrengthTable *tp, int street, int slot, double *ehs, double *ehs2)
+{
+    uint16_t *v = tp->values[street] + (size_t)slot * COMBOS_N * 2;
+    int i;
+
+    for (i = 0; i < COMBOS_N; i++) {
+	v[2 * i] = ehs[i] * 65535 + 0.5;
+	v[2 * i + 1] = ehs2[i] * 65535 + 0.5;
+    }
+    pthread_mutex_lock(&tp->lock);
+    tp->finished[street][slot] = 1;
+    pthread_mutex_unlock(&tp->lock);
+}
+
+/* Gets everything stored so far onto the disk, then marks it done
+   there (and the whole table, if complete) */
+
+int checkpoint_strength_table(StrengthTable *tp, int complete)
+{
+    int street, r;
+
+    pthread_mutex_lock(&tp->lock);
+    r = msync(tp->map, tp->size, MS_SYNC);
+    for (street = 0; street < 3; street++) {
+	if (tp->finished[street]) {
+	    memcpy(tp->done[street], tp->finished[street], tp->header->boards[street]);
+	}
+    }
+    tp->header->complete = complete;
+    r |= msync(tp->map, tp->size, MS_SYNC);
+    pthread_mutex_unlock(&tp->lock);
+    return r;
+}
+
+/* Returns -1 if the table hasn't this street (or this board yet), or
+   the hole isn't two cards clear of the board */
+
+int strength_lookup(StrengthTable *tp, CardMask hole, CardMask board, double *ehs, double *ehs2)
+{
+    CardMask one = hole & (hole - 1);
+    uint16_t *v;
+    long colex;
+    int cards, street, entry;
+
+    colex = colex_index(board, &cards);
+    street = cards - 3;
+    if (street < 0 || street > 2 || !(tp->header->streets & (1 << street))
+	|| !one || (one & (one - 1)) || (hole & board)) {
+	return -1;
+    }
+    entry = tp->index[street][colex];
+    if (!tp->done[street][entry >> 5]) {
+	return -1;
+    }
+    v = tp->values[street] + ((size_t)(entry >> 5) * COMBOS_N
+			      + combo_index(permute_suits(hole, entry & 31))) * 2;
+    *ehs = v[0] / 65535.0;
+    *ehs2 = v[1] / 65535.0;
+    return 0;
+}
+
+void close_strength_table(StrengthTable *tp)
+{
+    int street;
+
+    munmap(tp->map, tp->size);
+    close(tp->fd);
+    for (street = 0; street < 3; street++) {
+	free(tp->finished[street]);
+    }
+    pthread_mutex_destroy(&tp->lock);
+    free(tp);
+}
@@ -2,6 +2,8 @@
 #include <CUnit/Basic.h>
 #include <CUnit/CUError.h>
 #include "../cards.h"
+#include <math.h>
+#include <unistd.h>
 
 static int my_suite_init(void) { return 0; }
 static int my_suite_clean(void) { return 0; }
@@ -360,6 +362,797 @@ void test_pair_hash() {
     CU_ASSERT(!memcmp(kickers, k, 3 * sizeof(int)));
 }
 
+void test_card_index_and_mask()
+{
+    Card *cp = create_card("A", "spades");
+    CU_ASSERT_EQUAL(card_index(cp), 51);
+    set_rank(cp, "2");
+    set_suit(cp, "clubs");
+    CU_ASSERT_EQUAL(card_index(cp), 0);
+    set_suit(cp, "bells");
+    CU_ASSERT_EQUAL(card_index(cp), -1);
+    free_card(cp);
+
+    Hand *hand = sample_hand();
+    CardMask m = hand_mask(hand);
+    Hand *copy = mask_to_hand(m);
+    CU_ASSERT_EQUAL(copy->len, 5);
+    CU_ASSERT_EQUAL(hand_mask(copy), m);
+    free_hand(hand);
+    free_hand(copy);
+}
+
+void test_mask_strength()
+{
+    Hand *hand = sample_hand();
+    CU_ASSERT_EQUAL(mask_ranking(hand_mask(hand)), 7);
+    free_hand(hand);
+
+    Hand *wheel = create_batch_hand("A of clubs, 2 of hearts, 3 of clubs, 4 of spades, 5 of clubs");
+    Hand *six = create_batch_hand("2 of hearts, 3 of clubs, 4 of spades, 5 of clubs, 6 of clubs");
+    CU_ASSERT_EQUAL(mask_ranking(hand_mask(wheel)), 4);
+    CU_ASSERT(mask_strength(hand_mask(six)) > mask_strength(hand_mask(wheel)));
+    free_hand(wheel);
+    free_hand(six);
+
+    /* Seven cards: the third pair only counts as a kicker */
+    Hand *seven = create_batch_hand("9 of clubs, 9 of hearts, 4 of spades, 4 of clubs, 2 of clubs, 2 of hearts, 3 of spades");
+    Hand *five = create_batch_hand("9 of clubs, 9 of hearts, 4 of spades, 4 of clubs, 3 of hearts");
+    CU_ASSERT_EQUAL(mask_ranking(hand_mask(seven)), 6);
+    CU_ASSERT_EQUAL(mask_strength(hand_mask(seven)), mask_strength(hand_mask(five)));
+    free_hand(seven);
+    free_hand(five);
+}
+
+void test_river_outs()
+{
+    Hand *hole = create_batch_hand("A of hearts, 9 of hearts");
+    Hand *board = create_batch_hand("2 of hearts, K of hearts, 7 of clubs, J of spades");
+    Hand *opp = create_batch_hand("K of spades, K of diamonds");
+    Outs outs;
+
+    CU_ASSERT_EQUAL(count_outs(hand_mask(hole), hand_mask(board), 0, 1, &outs), 46);
+    CU_ASSERT_EQUAL(outs.ranking, 8);
+    CU_ASSERT_EQUAL(outs.outs[3], 9);
+    CU_ASSERT_EQUAL(__builtin_popcountll(outs.cards[3]), 9);
+    CU_ASSERT_EQUAL(outs.outs[7], 16);
+    CU_ASSERT_DOUBLE_EQUAL(outs.probability[3], 9.0 / 46, 1e-9);
+
+    /* Against trips only the flush is clean, and not the 7 or J of
+       hearts, which fill the opponent up */
+    count_outs(hand_mask(hole), hand_mask(board), hand_mask(opp), 1, &outs);
+    CU_ASSERT_EQUAL(outs.runouts, 44);
+    CU_ASSERT_EQUAL(outs.clean[3], 7);
+    CU_ASSERT_EQUAL(outs.clean[7], 0);
+
+    free_hand(hole);
+    free_hand(board);
+    free_hand(opp);
+}
+
+void test_flop_outs()
+{
+    Hand *hole = create_batch_hand("A of hearts, 9 of hearts");
+    Hand *board = create_batch_hand("2 of hearts, K of hearts, 7 of clubs");
+    Outs outs;
+
+    CU_ASSERT_EQUAL(count_outs(hand_mask(hole), hand_mask(board), 0, 2, &outs), 1081);
+    /* 1 - (38 * 37) / (47 * 46) of runouts bring a third heart or more */
+    CU_ASSERT_EQUAL(outs.outs[3] + outs.outs[0], 1081 - 703);
+    CU_ASSERT_EQUAL(outs.cards[3], 0);
+
+    free_hand(hole);
+    free_hand(board);
+}
+
+void test_batch_hand_skips_junk()
+{
+    Hand *hand = create_batch_hand("Q of hearts, junk, 1000 of spadesspadesspadesspades, 10 of spades");
+    CU_ASSERT_EQUAL(hand->len, 2);
+    CU_ASSERT_STRING_EQUAL(hand->cards[1]->rank, "10");
+    free_hand(hand);
+
+    hand = create_batch_hand("");
+    CU_ASSERT_EQUAL(hand->len, 0);
+    free_hand(hand);
+}
+
+void test_reference_value()
+{
+    int pair[] = { 1, 3, 11, 2, 1, -1 };
+    int wheel[] = { 4, 3, -1, -1, -1, -1 };
+    int short_pair[] = { 1, 12, 5, -1, -1, -1 };
+    int value[6];
+    Hand *hand = sample_hand();
+    reference_value(hand, value);
+    CU_ASSERT(!memcmp(value, pair, sizeof(pair)));
+    free_hand(hand);
+
+    hand = create_batch_hand("A of clubs, 2 of hearts, 3 of clubs, 4 of spades, 5 of clubs, K of clubs, 9 of hearts");
+    reference_value(hand, value);
+    CU_ASSERT(!memcmp(value, wheel, sizeof(wheel)));
+    CU_ASSERT_EQUAL(reference_ranking(hand), mask_ranking(hand_mask(hand)));
+    free_hand(hand);
+
+    hand = create_batch_hand("A of clubs, 7 of hearts, A of spades");
+    reference_value(hand, value);
+    CU_ASSERT(!memcmp(value, short_pair, sizeof(short_pair)));
+    CU_ASSERT_EQUAL(reference_ranking(hand), mask_ranking(hand_mask(hand)));
+    free_hand(hand);
+}
+
+void test_kickers_decide_ties()
+{
+    Hand *hand1 = create_batch_hand("K of clubs, K of spades, 9 of hearts, 4 of diamonds, 3 of hearts");
+    Hand *hand2 = create_batch_hand("K of hearts, K of diamonds, 9 of clubs, 4 of clubs, 2 of hearts");
+    CU_ASSERT(hand_beats_hand(hand1, hand2));
+    CU_ASSERT_EQUAL(reference_compare(hand1, hand2), 1);
+    free_hand(hand1);
+    free_hand(hand2);
+
+    hand1 = create_batch_hand("A of clubs, 2 of hearts, 3 of clubs, 4 of spades, 5 of clubs");
+    hand2 = create_batch_hand("2 of spades, 3 of hearts, 4 of clubs, 5 of hearts, 6 of clubs");
+    CU_ASSERT(hand_beats_hand(hand2, hand1));
+    CU_ASSERT_EQUAL(reference_compare(hand1, hand2), -1);
+    free_hand(hand1);
+    free_hand(hand2);
+}
+
+void test_hand_equity()
+{
+    Hand *aces = create_batch_hand("A of spades, A of hearts");
+    Hand *kings = create_batch_hand("K of spades, K of hearts");
+    Hand *board = create_batch_hand("2 of clubs, 7 of diamonds, 9 of spades, Q of clubs");
+    Equity eq;
+
+    /* Only the two kings left in the deck save the kings */
+    CU_ASSERT_EQUAL(hand_equity(hand_mask(aces), hand_mask(kings), hand_mask(board), &eq), 44);
+    CU_ASSERT_EQUAL(eq.wins, 42);
+    CU_ASSERT_EQUAL(eq.losses, 2);
+    CU_ASSERT_EQUAL(eq.ties, 0);
+    CU_ASSERT_DOUBLE_EQUAL(equity_share(&eq), 42.0 / 44, 1e-9);
+
+    free_hand(aces);
+    free_hand(kings);
+    free_hand(board);
+}
+
+void test_text_to_mask()
+{
+    Hand *hand = sample_hand();
+    CardMask m;
+    char *end;
+    char *text = "3 of hearts, 4 of diamonds, 5 of spades, K of spades, 5 of clubs; 10 of clubs";
+
+    CU_ASSERT_EQUAL(text_to_mask(text, &m, &end), 5);
+    CU_ASSERT_EQUAL(m, hand_mask(hand));
+    CU_ASSERT_EQUAL(*end, ';');
+    CU_ASSERT_EQUAL(text_to_mask(end + 1, &m, &end), 1);
+    CU_ASSERT_EQUAL(m, CARD_BIT(8));
+    CU_ASSERT_EQUAL(text_to_mask("3 of hearts, 3 of hearts", &m, NULL), -1);
+    CU_ASSERT_EQUAL(text_to_mask("3 of hearts, 1 of clubs", &m, NULL), -1);
+    CU_ASSERT_EQUAL(text_to_mask("3 of hearts 4 of clubs", &m, NULL), -1);
+    free_hand(hand);
+}
+
+void test_hand_file_round_trip()
+{
+    FILE *fp = tmpfile();
+    CardMask masks[1000], m, range[10];
+    int i, key, keys[10];
+    HandWriter *wp = create_hand_writer(fp, 7, HANDS_PACKED | HANDS_STRENGTH, 64);
+
+    for (i = 0; i < 1000; i++) {
+	masks[i] = (CardMask)0x7f << (i % 45);
+	CU_ASSERT_EQUAL(write_hand(wp, masks[i]), 0);
+    }
+    CU_ASSERT_EQUAL(write_hand(wp, 1), -1);
+    close_hand_writer(wp);
+
+    rewind(fp);
+    HandReader *rp = open_hand_reader(fp);
+    CU_ASSERT_PTR_NOT_NULL(rp);
+    CU_ASSERT_EQUAL(hand_reader_count(rp), 1000);
+    for (i = 0; read_hand(rp, &m, &key); i++) {
+	CU_ASSERT_EQUAL(m, masks[i]);
+	CU_ASSERT_EQUAL(key, mask_strength(m));
+    }
+    CU_ASSERT_EQUAL(i, 1000);
+
+    /* Across a block boundary, and off the end */
+    CU_ASSERT_EQUAL(read_hand_range(rp, 60, 10, range, keys), 10);
+    CU_ASSERT_EQUAL(range[9], masks[69]);
+    CU_ASSERT_EQUAL(keys[4], mask_strength(masks[64]));
+    CU_ASSERT_EQUAL(read_hand_range(rp, 995, 10, range, NULL), 5);
+    close_hand_reader(rp);
+    fclose(fp);
+}
+
+void test_hand_file_truncated()
+{
+    FILE *fp = tmpfile();
+    CardMask range[1000];
+    HandBlockHeader bad = { 64, 0 };
+    HandReader *rp;
+    HandWriter *wp = create_hand_writer(fp, 5, HANDS_PACKED, 64);
+    long full = sizeof(HandBlockHeader) + 64 * 5;
+    int i;
+
+    for (i = 0; i < 1000; i++) {
+	write_hand(wp, (CardMask)0x1f << (i % 47));
+    }
+    close_hand_writer(wp);
+
+    /* The header still says 1000, but only three and a half blocks are left */
+    CU_ASSERT_EQUAL(ftruncate(fileno(fp), sizeof(HandFileHeader) + 3 * full + full / 2), 0);
+    rewind(fp);
+    rp = open_hand_reader(fp);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(rp);
+    CU_ASSERT_EQUAL(hand_reader_count(rp), 192);
+    CU_ASSERT_EQUAL(read_hand_range(rp, 0, 1000, range, NULL), 192);
+    CU_ASSERT_EQUAL(range[191], (CardMask)0x1f << (191 % 47));
+    CU_ASSERT_EQUAL(read_hand_range(rp, 500, 10, range, NULL), 0);
+    close_hand_reader(rp);
+
+    /* A block header that's been overwritten */
+    fseek(fp, sizeof(HandFileHeader) + full, SEEK_SET);
+    fwrite(&bad, sizeof(bad), 1, fp);
+    fflush(fp);
+    rewind(fp);
+    rp = open_hand_reader(fp);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(rp);
+    CU_ASSERT_EQUAL(read_hand_range(rp, 10, 10, range, NULL), 10);
+    CU_ASSERT_EQUAL(read_hand_range(rp, 60, 10, range, NULL), -1);
+    close_hand_reader(rp);
+    fclose(fp);
+}
+
+void test_philox()
+{
+    uint32_t out[4];
+    philox(0, 0, 0, out);
+    CU_ASSERT_EQUAL(out[0], 0x6627e8d5);
+    CU_ASSERT_EQUAL(out[3], 0x9b00dbd8);
+    CU_ASSERT_EQUAL(random_below(0xffffffff, 47), 46);
+    CU_ASSERT_EQUAL(random_below(0, 47), 0);
+}
+
+void test_monte_carlo_shards_merge_exactly()
+{
+    CardMask aces, kings;
+    McResult whole, shard1, shard2;
+    uint64_t first, count;
+
+    text_to_mask("A of spades, A of hearts", &aces, NULL);
+    text_to_mask("K of spades, K of hearts", &kings, NULL);
+    init_mc_result(&whole, aces, kings, 0, 7, 0);
+    monte_carlo(&whole, 30000);
+
+    /* Shard 1 of 2 in two goes, as if resumed, then shard 0 */
+    CU_ASSERT_EQUAL(parse_shard("1/2", 30000, &first, &count), 0);
+    CU_ASSERT_EQUAL(first, 15000);
+    init_mc_result(&shard2, aces, kings, 0, 7, first);
+    monte_carlo(&shard2, 10000);
+    monte_carlo(&shard2, count - 10000);
+    parse_shard("0/2", 30000, &first, &count);
+    init_mc_result(&shard1, aces, kings, 0, 7, first);
+    monte_carlo(&shard1, count);
+
+    CU_ASSERT_EQUAL(merge_mc_result(&shard2, &shard1), 0);
+    CU_ASSERT(!memcmp(&whole, &shard2, sizeof(McResult)));
+    CU_ASSERT_EQUAL(merge_mc_result(&shard2, &shard1), -1);
+    CU_ASSERT(fabs(mc_equity(&whole) - 0.8264) < 4 * mc_error(&whole));
+
+    CU_ASSERT_EQUAL(parse_shard("2/2", 30000, &first, &count), -1);
+    CU_ASSERT_EQUAL(parse_shard("2/3", 10, &first, &count), 0);
+    CU_ASSERT_EQUAL(first, 7);
+    CU_ASSERT_EQUAL(count, 3);
+}
+
+void test_board_ranking()
+{
+    static BoardRanking br;
+    static double range1[COMBOS_N], range2[COMBOS_N];
+    CardMask board, combo;
+    Equity e;
+    double want = 0, weight = 0;
+    int i, j, a, b;
+
+    for (i = 0; i < COMBOS_N; i++) {
+	CU_ASSERT_EQUAL(combo_index(index_combo(i)), i);
+    }
+    text_to_mask("2 of clubs, 7 of diamonds, 9 of hearts, K of spades, K of clubs",
+		 &board, NULL);
+    CU_ASSERT_EQUAL(rank_board(board, 0, &br), 1081);
+    for (i = 1; i < br.n; i++) {
+	CU_ASSERT(br.keys[i - 1] <= br.keys[i]);
+	CU_ASSERT_EQUAL(br.ranks[i], br.ranks[i - 1] + (br.keys[i] != br.keys[i - 1]));
+	CU_ASSERT_EQUAL(br.keys[i], mask_strength(br.combos[i] | board));
+    }
+    CU_ASSERT_EQUAL(br.groups, br.ranks[br.n - 1] + 1);
+    CU_ASSERT_EQUAL(br.group_start[br.groups], br.n);
+
+    /* Pocket pairs against suited aces, checked pair by pair */
+    for (i = 0; i < br.n; i++) {
+	combo = br.combos[i];
+	a = __builtin_ctzll(combo);
+	b = 63 - __builtin_clzll(combo);
+	range1[combo_index(combo)] = a % 13 == b % 13;
+	range2[combo_index(combo)] = b % 13 == 12 && a / 13 == b / 13;
+    }
+    for (i = 0; i < br.n; i++) {
+	for (j = 0; j < br.n; j++) {
+	    if (range1[combo_index(br.combos[i])] && range2[combo_index(br.combos[j])]
+		&& !(br.combos[i] & br.combos[j])) {
+		hand_equity(br.combos[i], br.combos[j], board, &e);
+		want += e.wins + e.ties / 2.0;
+		weight++;
+	    }
+	}
+    }
+    CU_ASSERT(fabs(range_equity(&br, range1, range2) - want / weight) < 1e-9);
+}
+
+void test_street_strengths()
+{
+    static double ehs[COMBOS_N], ehs2[COMBOS_N];
+    char path[] = "/tmp/strengthsXXXXXX";
+    CardMask hole, board, turn, opp, river;
+    StrengthTable *tp;
+    double hs, sum = 0, sum2 = 0, e, e2;
+    int key, theirs, won, met, runouts = 0, slot, perm, a, b, r;
+
+    /* A flush draw on the turn, against working it out by hand */
+    text_to_mask("A of hearts, 5 of hearts", &hole, NULL);
+    text_to_mask("K of hearts, 9 of hearts, 2 of clubs, 7 of spades", &turn, NULL);
+    for (r = 0; r < 52; r++) {
+	river = turn | CARD_BIT(r);
+	if ((hole | turn) & CARD_BIT(r)) {
+	    continue;
+	}
+	key = mask_strength(hole | river);
+	won = met = 0;
+	for (b = 1; b < 52; b++) {
+	    for (a = 0; a < b; a++) {
+		opp = CARD_BIT(a) | CARD_BIT(b);
+		if (!(opp & (hole | river))) {
+		    theirs = mask_strength(opp | river);
+		    won += (key > theirs) * 2 + (key == theirs);
+		    met += 2;
+		}
+	    }
+	}
+	hs = (double)won / met;
+	sum += hs;
+	sum2 += hs * hs;
+	runouts++;
+    }
+    street_strengths(turn, ehs, ehs2);
+    CU_ASSERT(fabs(ehs[combo_index(hole)] - sum / runouts) < 1e-9);
+    CU_ASSERT(fabs(ehs2[combo_index(hole)] - sum2 / runouts) < 1e-9);
+    CU_ASSERT(ehs2[combo_index(hole)] > ehs[combo_index(hole)] * ehs[combo_index(hole)]);
+
+    /* One flop stored, then looked up with its suits swapped around */
+    close(mkstemp(path));
+    tp = create_strength_table(path, STRENGTH_FLOP);
+    CU_ASSERT_EQUAL(strength_table_boards(tp, 0), 1755);
+    text_to_mask("K of hearts, 9 of hearts, 2 of clubs", &board, NULL);
+    board = canonical_board(board, &perm);
+    for (slot = 0; strength_table_board(tp, 0, slot) != board; slot++)
+	;
+    street_strengths(board, ehs, ehs2);
+    store_strengths(tp, 0, slot, ehs, ehs2);
+    CU_ASSERT_EQUAL(checkpoint_strength_table(tp, 0), 0);
+    close_strength_table(tp);
+
+    tp = open_strength_table(path, 0);
+    text_to_mask("K of hearts, 9 of hearts, 2 of clubs", &board, NULL);
+    CU_ASSERT_EQUAL(strength_lookup(tp, hole, board, &e, &e2), 0);
+    street_strengths(board, ehs, ehs2);
+    CU_ASSERT(fabs(e - ehs[combo_index(hole)]) < 1e-4);
+    CU_ASSERT(fabs(e2 - ehs2[combo_index(hole)]) < 1e-4);
+    CU_ASSERT_EQUAL(strength_lookup(tp, hole, turn, &e, &e2), -1);
+    text_to_mask("K of spades, 9 of spades, 3 of clubs", &board, NULL);
+    CU_ASSERT_EQUAL(strength_lookup(tp, hole, board, &e, &e2), -1);
+    close_strength_table(tp);
+
+    /* A file cut short isn't opened at all */
+    CU_ASSERT_EQUAL(truncate(path, 4096), 0);
+    CU_ASSERT_PTR_NULL(open_strength_table(path, 0));
+    unlink(path);
+}
+
+void test_showdown_and_side_pots()
+{
+    CardMask holes[4], board;
+    int keys[4];
+    long bets[4] = { 100, 40, 100, 100 }, won[4];
+    unsigned winners;
+    char name[4];
+
+    /* Seat 1's full house beats the same straight for seats 0 and 2;
+       seat 3 has folded */
+    CU_ASSERT_EQUAL(text_to_mask("9 of clubs, 10 of diamonds, J of hearts, 2 of spades, 2 of clubs",
+				 &board, NULL), 5);
+    text_to_mask("Q of clubs, K of hearts", &holes[0], NULL);
+    text_to_mask("2 of hearts, 9 of hearts", &holes[1], NULL);
+    text_to_mask("Q of spades, K of diamonds", &holes[2], NULL);
+    holes[3] = 0;
+    showdown(holes, 4, board, keys, &winners);
+    CU_ASSERT_EQUAL(winners, 1u << 1);
+    CU_ASSERT_EQUAL(STRENGTH_RANKING(keys[1]), 2);
+    CU_ASSERT_EQUAL(STRENGTH_RANKING(keys[0]), 4);
+    CU_ASSERT_EQUAL(keys[0], keys[2]);
+    CU_ASSERT_EQUAL(keys[3], -1);
+
+    /* The full house wins the 121 it can reach; the straights split
+       the rest */
+    bets[3] = 1;
+    CU_ASSERT_EQUAL(split_pots(keys, bets, 4, won), 0);
+    CU_ASSERT_EQUAL(won[1], 121);
+    CU_ASSERT_EQUAL(won[0], 60);
+    CU_ASSERT_EQUAL(won[2], 60);
+    CU_ASSERT_EQUAL(won[3], 0);
+    /* Three chips split two ways: the odd one goes to seat 0 */
+    bets[1] = 1;
+    bets[3] = 2;
+    split_pots(keys, bets, 4, won);
+    CU_ASSERT_EQUAL(won[1], 4);
+    CU_ASSERT_EQUAL(won[0], 100);
+    CU_ASSERT_EQUAL(won[2], 99);
+
+    CU_ASSERT_STRING_EQUAL(starting_hand_name(name, starting_hand(holes[0])), "KQo");
+    text_to_mask("A of hearts, A of spades", &holes[0], NULL);
+    CU_ASSERT_STRING_EQUAL(starting_hand_name(name, starting_hand(holes[0])), "AA");
+    text_to_mask("7 of hearts, 2 of hearts", &holes[0], NULL);
+    CU_ASSERT_STRING_EQUAL(starting_hand_name(name, starting_hand(holes[0])), "72s");
+}
+
+void test_table_simulation()
+{
+    static TableStats whole, part1, part2;
+    uint64_t dealt = 0, shares = 0;
+    int i;
+
+    init_table_stats(&whole, 6, 3, 0);
+    simulate_table(&whole, 20000);
+    init_table_stats(&part1, 6, 3, 0);
+    simulate_table(&part1, 5000);
+    init_table_stats(&part2, 6, 3, 5000);
+    simulate_table(&part2, 15000);
+    CU_ASSERT_EQUAL(merge_table_stats(&part2, &part1), 0);
+    CU_ASSERT(!memcmp(&whole, &part2, sizeof(TableStats)));
+
+    for (i = 0; i < STARTING_HANDS; i++) {
+	dealt += whole.dealt[i];
+	shares += whole.shares[i];
+	CU_ASSERT(whole.wins[i] + whole.ties[i] <= whole.dealt[i]);
+    }
+    CU_ASSERT_EQUAL(dealt, 6 * 20000);
+    CU_ASSERT_EQUAL(shares, (uint64_t)SHARE_UNIT * 20000);
+}
+
+void test_draw_outcomes()
+{
+    static double payouts[RANKINGS_N] = { 50, 25, 9, 6, 4, 3, 2, 1, 0 };
+    DrawOutcome outcomes[32];
+    DrawTable *tp;
+    CardMask hand, keep, draw, live;
+    long counts[RANKINGS_N] = { 0 }, draws = 0;
+    double value, table_value;
+    int a, b, c, r, hold;
+
+    /* Holding the ace and king of hearts (bits 2 and 3: below the
+       spade, above the club and diamond), against dealing out all three
+       new cards */
+    text_to_mask("A of hearts, K of hearts, 9 of clubs, 4 of spades, 2 of diamonds",
+		 &hand, NULL);
+    text_to_mask("A of hearts, K of hearts", &keep, NULL);
+    draw_outcomes(hand, outcomes);
+    live = ((CARD_BIT(52)) - 1) & ~hand;
+    for (c = 2; c < 52; c++) {
+	for (b = 1; b < c; b++) {
+	    for (a = 0; a < b; a++) {
+		draw = CARD_BIT(a) | CARD_BIT(b) | CARD_BIT(c);
+		if ((draw & live) == draw) {
+		    counts[mask_ranking(keep | draw)]++;
+		    draws++;
+		}
+	    }
+	}
+    }
+    for (a = 0, hold = 0, draw = hand; a < 5; a++, draw &= draw - 1) {
+	hold |= (draw & -draw & keep) ? 1 << a : 0;
+    }
+    CU_ASSERT_EQUAL(hold, 12);
+    CU_ASSERT_EQUAL(outcomes[hold].draws, 16215);
+    CU_ASSERT_EQUAL(draws, 16215);
+    for (r = 0; r < RANKINGS_N; r++) {
+	CU_ASSERT_EQUAL(outcomes[hold].counts[r], counts[r]);
+    }
+    CU_ASSERT_EQUAL(outcomes[0].draws, 1533939);
+    CU_ASSERT_EQUAL(outcomes[31].draws, 1);
+    CU_ASSERT_EQUAL(outcomes[31].counts[8], 1);
+
+    /* The same hand in other suits, from the table */
+    text_to_mask("A of hearts, K of hearts, Q of hearts, J of hearts, 3 of clubs", &hand, NULL);
+    text_to_mask("A of hearts, K of hearts, Q of hearts, J of hearts", &keep, NULL);
+    CU_ASSERT_EQUAL(best_hold(hand, payouts, &value), keep);
+    tp = make_draw_table(payouts);
+    CU_ASSERT_EQUAL(tp->n, 134459);
+    text_to_mask("A of clubs, K of clubs, Q of clubs, J of clubs, 3 of spades", &hand, NULL);
+    text_to_mask("A of clubs, K of clubs, Q of clubs, J of clubs", &keep, NULL);
+    CU_ASSERT_EQUAL(draw_table_hold(tp, hand, &table_value), keep);
+    CU_ASSERT(fabs(table_value - value) < 1e-12);
+    free_draw_table(tp);
+}
+
+/* The best mask_strength of m with wilds more cards, each from from
+   up and none of them in m */
+
+static int best_substitution(CardMask m, int wilds, int from)
+{
+    int c, key, best = 0;
+
+    if (!wilds) {
+	return mask_strength(m);
+    }
+    for (c = from; c < 52; c++) {
+	if (!(m & CARD_BIT(c)) && (key = best_substitution(m | CARD_BIT(c), wilds - 1, c + 1)) > best) {
+	    best = key;
+	}
+    }
+    return best;
+}
+
+void test_wild_strength()
+{
+    CardMask m, natural;
+    int i, c, n, key, best, wilds;
+    unsigned wild_ranks;
+
+    text_to_mask("A of spades, A of hearts, A of clubs, A of diamonds", &m, NULL);
+    key = wild_strength(m, 1, 0);
+    CU_ASSERT_EQUAL(STRENGTH_RANKING(key), FIVE_OF_A_KIND);
+    CU_ASSERT_EQUAL(key, 9 << 20 | 13 << 16);
+    CU_ASSERT_STRING_EQUAL(strength_description(key), "five of a kind");
+    CU_ASSERT_STRING_EQUAL(strength_description(mask_strength(m)), "four of a kind");
+    text_to_mask("K of hearts, Q of hearts, J of hearts, 10 of hearts, 3 of clubs", &m, NULL);
+    CU_ASSERT_EQUAL(wild_strength(m, 1, 0), 8 << 20 | 13 << 16);
+    CU_ASSERT_EQUAL(wild_strength(m, 0, 0), mask_strength(m));
+
+    /* Deuces wild: two of them with a pair of 7s is four 7s */
+    text_to_mask("2 of clubs, 2 of diamonds, 7 of spades, 7 of hearts, 9 of clubs", &m, NULL);
+    CU_ASSERT_EQUAL(wild_strength(m, 0, 1), 7 << 20 | 6 << 16 | 8 << 12);
+
+    /* Against putting every card in place of a joker in turn */
+    srand(11);
+    for (i = 0; i < 300; i++) {
+	for (m = 0, n = 4 + rand() % 3; __builtin_popcountll(m) < n; ) {
+	    m |= CARD_BIT(rand() % 52);
+	}
+	if (STRENGTH_RANKING(key = wild_strength(m, 1, 0)) == FIVE_OF_A_KIND) {
+	    continue;
+	}
+	for (c = 0, best = 0; c < 52; c++) {
+	    if (!(m & CARD_BIT(c)) && mask_strength(m | CARD_BIT(c)) > best) {
+		best = mask_strength(m | CARD_BIT(c));
+	    }
+	}
+	CU_ASSERT_EQUAL(key, best);
+    }
+
+    /* Two wilds and nothing else, jokers or deuces, are a pair of aces */
+    CU_ASSERT_EQUAL(wild_strength(0, 2, 0), 1 << 20 | 13 << 16);
+    CU_ASSERT_EQUAL(wild_strength(CARD_BIT(0) | CARD_BIT(13), 0, 1), 1 << 20 | 13 << 16);
+
+    /* Two to four jokers, against every set of cards in their place */
+    for (i = 0; i < 120; i++) {
+	wilds = 2 + i % 3;
+	for (m = 0, n = rand() % (8 - wilds); __builtin_popcountll(m) < n; ) {
+	    m |= CARD_BIT(rand() % 52);
+	}
+	if (STRENGTH_RANKING(key = wild_strength(m, wilds, 0)) != FIVE_OF_A_KIND) {
+	    CU_ASSERT_EQUAL(key, best_substitution(m, wilds, 0));
+	}
+    }
+
+    /* And wild ranks: the cards of those ranks go, and as many are
+       put back, anything but the cards that are left */
+    for (i = 0; i < 200; i++) {
+	wild_ranks = 1u << rand() % 13 | (i & 1 ? 1u << rand() % 13 : 0);
+	for (m = 0, n = 5 + rand() % 3; __builtin_popcountll(m) < n; ) {
+	    m |= CARD_BIT(rand() % 52);
+	}
+	for (c = 0, natural = m; c < 52; c++) {
+	    if (wild_ranks & 1u << c % 13) {
+		natural &= ~CARD_BIT(c);
+	    }
+	}
+	wilds = n - __builtin_popcountll(natural);
+	if (wilds <= 4 && STRENGTH_RANKING(key = wild_strength(m, 0, wild_ranks)) != FIVE_OF_A_KIND) {
+	    CU_ASSERT_EQUAL(key, best_substitution(natural, wilds, 0));
+	}
+    }
+}
+
+void test_sampling_modes()
+{
+    CardMask hole1, hole2, flop, turn;
+    Equity e;
+    Estimate est;
+    double exact;
+    int mode;
+
+    text_to_mask("A of hearts, 5 of hearts", &hole1, NULL);
+    text_to_mask("K of spades, K of clubs", &hole2, NULL);
+    text_to_mask("K of hearts, 9 of hearts, 2 of clubs", &flop, NULL);
+    hand_equity(hole1, hole2, flop, &e);
+    exact = equity_share(&e);
+    for (mode = 0; mode < SAMPLE_MODES; mode++) {
+	CU_ASSERT_EQUAL(estimate_equity(hole1, hole2, flop, mode, 4000, 5, &est), 0);
+	CU_ASSERT(est.evaluations > 3000 && est.evaluations <= 4000);
+	CU_ASSERT(est.error > 0 && est.error < 0.01);
+	CU_ASSERT(fabs(est.equity - exact) < 4 * est.error);
+	CU_ASSERT(est.low < est.equity && est.equity < est.high);
+    }
+
+    /* One card to come: the strata are the runouts */
+    text_to_mask("K of hearts, 9 of hearts, 2 of clubs, 7 of spades", &turn, NULL);
+    hand_equity(hole1, hole2, turn, &e);
+    estimate_equity(hole1, hole2, turn, SAMPLE_STRATIFIED, 1000, 5, &est);
+    CU_ASSERT(fabs(est.equity - equity_share(&e)) < 1e-12);
+    CU_ASSERT_EQUAL(est.evaluations, 44);
+    CU_ASSERT_EQUAL(estimate_equity(hole1, hole2, turn, SAMPLE_MODES, 1000, 5, &est), -1);
+}
+
+void test_history_stats()
+{
+    static HistoryStats stats, more;
+    char log[] =
+	"# flop, turn, river, seats\n"
+	"A of spades, 7 of hearts, 2 of clubs; K of diamonds; 7 of clubs; "
+	"A of hearts, Q of clubs; 7 of spades, 7 of diamonds\n"
+	"\n"
+	"A of spades, 7 of hearts, 2 of clubs; K of diamonds; A of spades; "
+	"A of hearts, Q of clubs; 7 of spades, 7 of diamonds\n"
+	"2 of hearts, 3 of hearts, 4 of hearts; 5 of clubs; 9 of spades; "
+	"K of clubs, K of spades; A of hearts, 9 of diamonds";
+    char *p = log, *end = log + strlen(log);
+    int aa = starting_hand(CARD_BIT(12) | CARD_BIT(25)), kk = starting_hand(CARD_BIT(11) | CARD_BIT(24));
+
+    init_history_stats(&stats);
+    CU_ASSERT_EQUAL(log_showdown(&stats, p, &p), 0);
+    CU_ASSERT_EQUAL(log_showdown(&stats, p, &p), 2);
+    CU_ASSERT_EQUAL(log_showdown(&stats, p, &p), 0);
+    CU_ASSERT_EQUAL(log_showdown(&stats, p, &p), -1);    /* the A of spades twice */
+    CU_ASSERT_EQUAL(log_showdown(&stats, p, &p), 2);
+    CU_ASSERT(p == end);
+
+    CU_ASSERT_EQUAL(stats.hands, 2);
+    CU_ASSERT_EQUAL(stats.rejected, 1);
+    /* The sevens led all the way; the kings led on the flop but the
+       A of hearts, 9 of diamonds made a straight on the turn and held */
+    CU_ASSERT_EQUAL(stats.shown[1], 1);
+    CU_ASSERT_EQUAL(stats.won[1], 1);
+    CU_ASSERT_EQUAL(stats.won[4], 1);
+    CU_ASSERT_EQUAL(stats.leads[0], 2);
+    CU_ASSERT_EQUAL(stats.held[0], 1);
+    CU_ASSERT_EQUAL(stats.leads[1], 2);
+    CU_ASSERT_EQUAL(stats.held[1], 2);
+    CU_ASSERT_EQUAL(stats.dealt[kk], 1);
+    CU_ASSERT_EQUAL(stats.wins[kk], 0);
+    CU_ASSERT_EQUAL(stats.shares[aa], 0);
+
+    init_history_stats(&more);
+    merge_history_stats(&more, &stats);
+    merge_history_stats(&more, &stats);
+    CU_ASSERT_EQUAL(more.hands, 4);
+    CU_ASSERT_EQUAL(more.held[1], 4);
+}
+
+void test_lookup_table()
+{
+    LookupTable *tp = make_lookup_table(2);
+    CardMask m;
+    int i;
+
+    CU_ASSERT_PTR_NOT_NULL_FATAL(tp);
+    CU_ASSERT_EQUAL(tp->n, LOOKUP_CLASSES);
+    for (i = 1; i < tp->n; i++) {
+	CU_ASSERT(tp->keys[i - 1] < tp->keys[i]);
+    }
+    srand(7);
+    for (i = 0; i < 100000; i++) {
+	for (m = 0; __builtin_popcountll(m) < 7; ) {
+	    m |= CARD_BIT(rand() % 52);
+	}
+	CU_ASSERT_EQUAL(lookup_strength(tp, m), mask_strength(m));
+    }
+    m = CARD_BIT(7) - 1;
+    CU_ASSERT_EQUAL(lookup_strength(tp, m), mask_strength(m));
+    m = CARD_BIT(52) - CARD_BIT(45);
+    CU_ASSERT_EQUAL(lookup_strength(tp, m), 8 << 20 | 13 << 16);
+    /* Fewer cards, or no table, and it's mask_strength */
+    CU_ASSERT_EQUAL(lookup_strength(tp, m & (m - 1)), mask_strength(m & (m - 1)));
+    CU_ASSERT_EQUAL(lookup_strength(NULL, m), mask_strength(m));
+    free_lookup_table(tp);
+}
+
+void test_mask_category()
+{
+    static long exact[RANKINGS_N] = { 40, 624, 3744, 5108, 10200, 54912, 123552, 1098240, 1302540 };
+    long counts[RANKINGS_N] = { 0 };
+    CardMask *masks = malloc(2598960 * sizeof(CardMask)), m, low;
+    long n = 0;
+    int i, r, mismatches = 0;
+
+    /* Every five-card hand */
+    for (m = CARD_BIT(5) - 1; m < CARD_BIT(52); ) {
+	masks[n++] = m;
+	low = m & -m;
+	m = ((((m + low) ^ m) >> 2) / low) | (m + low);
+    }
+    mask_category_counts(masks, n, counts);
+    for (r = 0; r < RANKINGS_N; r++) {
+	CU_ASSERT_EQUAL(counts[r], exact[r]);
+    }
+    /* Adding on: the 2 to 6 of clubs, then two clubs flushes */
+    mask_category_counts(masks, 3, counts);
+    CU_ASSERT_EQUAL(counts[0], exact[0] + 1);
+    CU_ASSERT_EQUAL(counts[3], exact[3] + 2);
+
+    srand(11);
+    for (i = 0; i < 200000; i++) {
+	for (m = 0; __builtin_popcountll(m) < 5 + i % 3; ) {
+	    m |= CARD_BIT(rand() % 52);
+	}
+	mismatches += mask_category(m) != mask_ranking(m);
+    }
+    CU_ASSERT_EQUAL(mismatches, 0);
+    free(masks);
+}
+
+void test_inline_hand()
+{
+    Hand *hand = create_batch_hand("K of hearts, 2 of clubs, K of spades, 9 of diamonds, K of clubs");
+    Hand *back;
+    InlineHand h, copy, *hands;
+    int i;
+
+    CU_ASSERT_EQUAL(sizeof(InlineHand), 64);
+    CU_ASSERT_EQUAL(hand_to_inline(hand, &h), 0);
+    CU_ASSERT_EQUAL(h.len, 5);
+    CU_ASSERT_EQUAL(h.cards[0], 2 * 13 + 11);
+    CU_ASSERT_EQUAL(h.mask, hand_mask(hand));
+    CU_ASSERT_EQUAL(h.rank_counts[11], 3);
+    CU_ASSERT_EQUAL(h.rank_counts[0], 1);
+    CU_ASSERT_EQUAL(h.suit_counts[0], 2);
+    memcpy(&copy, &h, sizeof(InlineHand));
+    back = inline_to_hand(&copy);
+    CU_ASSERT_EQUAL(back->len, hand->len);
+    for (i = 0; i < hand->len; i++) {
+	CU_ASSERT(card_eq(back->cards[i], hand->cards[i]));
+    }
+    CU_ASSERT_EQUAL(hand_ranking(back), hand_ranking(hand));
+    free_hand(back);
+
+    add_card_to_hand(hand, "K", "hearts");
+    CU_ASSERT_EQUAL(hand_to_inline(hand, &h), -1);
+    CU_ASSERT_EQUAL(h.len, 0);
+    free_hand(hand);
+
+    CU_ASSERT_EQUAL(mask_to_inline(CARD_BIT(8) - 1, &h), -1);
+    CU_ASSERT_EQUAL(mask_to_inline(CARD_BIT(7) - 1, &h), 0);
+    CU_ASSERT_EQUAL(mask_strength(h.mask), 8 << 20 | 7 << 16);
+    hands = create_inline_hands(3);
+    CU_ASSERT_EQUAL((uintptr_t)hands % 64, 0);
+    hands[2] = h;
+    CU_ASSERT_EQUAL(hands[2].cards[6], 6);
+    CU_ASSERT_EQUAL(hands[1].len, 0);
+    free(hands);
+}
+
 int main()
 {
     CU_BasicRunMode mode = CU_BRM_VERBOSE;
@@ -374,12 +1167,14 @@ int main()
     CU_set_error_action(error_action);
 
     CU_pSuite cardBasics, handCreation, handRanking, handContents, handComparison;
+    CU_pSuite cardMasks;
 
     cardBasics = CU_add_suite("Card basics", my_suite_init, my_suite_clean);
     handCreation = CU_add_suite("Hand creation and initialization", my_suite_init, my_suite_clean);
     handRanking = CU_add_suite("Hand ranking routines", my_suite_init, my_suite_clean);
     handComparison = CU_add_suite("Hand comparison routines", my_suite_init, my_suite_clean);
     handContents = CU_add_suite("Hand content routines", my_suite_init, my_suite_clean);
+    cardMasks = CU_add_suite("Card masks and outs", my_suite_init, my_suite_clean);
 
     CU_ADD_TEST(cardBasics, test_pretty_formatting);
     CU_ADD_TEST(cardBasics, test_card_comparison);
@@ -388,6 +1183,7 @@ int main()
 
     CU_ADD_TEST(handCreation, test_create_hand_with_multiple_specs);
     CU_ADD_TEST(handCreation, test_add_card_to_hand);
+    CU_ADD_TEST(handCreation, test_batch_hand_skips_junk);
 
     CU_ADD_TEST(handRanking, test_rank_index);
     CU_ADD_TEST(handRanking, test_reporting_rank_of_hand);
@@ -413,6 +1209,30 @@ int main()
     CU_ADD_TEST(handComparison, test_high_straight_flush_wins);
    CU_ADD_TEST(handComparison, test_pair_hash);
     CU_ADD_TEST(handComparison, test_high_card_wins_on_tied_two_pairs);
+    CU_ADD_TEST(handComparison, test_kickers_decide_ties);
+    CU_ADD_TEST(handComparison, test_reference_value);
+
+    CU_ADD_TEST(cardMasks, test_card_index_and_mask);
+    CU_ADD_TEST(cardMasks, test_text_to_mask);
+    CU_ADD_TEST(cardMasks, test_mask_strength);
+    CU_ADD_TEST(cardMasks, test_river_outs);
+    CU_ADD_TEST(cardMasks, test_flop_outs);
+    CU_ADD_TEST(cardMasks, test_hand_equity);
+    CU_ADD_TEST(cardMasks, test_hand_file_round_trip);
+    CU_ADD_TEST(cardMasks, test_hand_file_truncated);
+    CU_ADD_TEST(cardMasks, test_philox);
+    CU_ADD_TEST(cardMasks, test_monte_carlo_shards_merge_exactly);
+    CU_ADD_TEST(cardMasks, test_board_ranking);
+    CU_ADD_TEST(cardMasks, test_street_strengths);
+    CU_ADD_TEST(cardMasks, test_showdown_and_side_pots);
+    CU_ADD_TEST(cardMasks, test_table_simulation);
+    CU_ADD_TEST(cardMasks, test_draw_outcomes);
+    CU_ADD_TEST(cardMasks, test_wild_strength);
+    CU_ADD_TEST(cardMasks, test_sampling_modes);
+    CU_ADD_TEST(cardMasks, test_history_stats);
+    CU_ADD_TEST(cardMasks, test_lookup_table);
+    CU_ADD_TEST(cardMasks, test_mask_category);
+    CU_ADD_TEST(cardMasks, test_inline_hand);
     
     CU_basic_run_tests();
     CU_cleanup_registry();
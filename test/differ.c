@@ -0,0 +1,359 @@
+/* differ.c -- check every hand comparison path against reference.c
+
+Usage:
+
+  test/differ random [n] [seed]        n random pairs of 5- and 7-card hands
+  test/differ adversarial [n] [seed]   n pairs built to be close calls
+  test/differ exhaustive               every 5-card hand against its neighbour
+  test/differ wild [n] [seed]          n pairs with one to three wild cards each
+
+Each path in the paths array below is asked to compare the same pair
+of hands as reference_compare. The first disagreement is printed, with
+the cards spelled out, and the exit status is 1.
+
+wild checks wild_strength with jokers or deuces wild instead. Each
+hand's reference is the best the reference evaluator makes of it with
+every set of cards in place of the wilds, so n is kept small.
+
+*/
+
+#include "../cards.h"
+#include <string.h>
+#include <unistd.h>
+
+typedef struct {
+    char *name;
+    int max_cards;
+    int (*compare)(Hand *, Hand *);
+} comparison_path;
+
+static int sign(int n)
+{
+    return (n > 0) - (n < 0);
+}
+
+static int legacy_compare(Hand *hand1, Hand *hand2)
+{
+    return sign(compare_hands(hand1, hand2));
+}
+
+static int mask_compare(Hand *hand1, Hand *hand2)
+{
+    return sign(mask_strength(hand_mask(hand1)) - mask_strength(hand_mask(hand2)));
+}
+
+/* With no wild cards it has to be mask_strength over again */
+
+static int wild_compare(Hand *hand1, Hand *hand2)
+{
+    return sign(wild_strength(hand_mask(hand1), 0, 0) - wild_strength(hand_mask(hand2), 0, 0));
+}
+
+/* The table is built for the first seven-card hand (anything smaller
+   goes to mask_strength anyway), so exhaustive never pays for it */
+
+static int lookup_compare(Hand *hand1, Hand *hand2)
+{
+    static LookupTable *table;
+
+    if (!table && hand1->len + hand2->len == 14
+	&& (table = make_lookup_table(sysconf(_SC_NPROCESSORS_ONLN))) == NULL) {
+	fprintf(stderr, "not enough memory for the lookup table\n");
+	exit(2);
+    }
+    return sign(lookup_strength(table, hand_mask(hand1)) - lookup_strength(table, hand_mask(hand2)));
+}
+
+/* Categories count from 0 for a straight flush, so the lower wins.
+   Within one, mask_strength (checked on its own above) decides, so a
+   mismatch here is a hand put in the wrong category. */
+
+static int category_compare(Hand *hand1, Hand *hand2)
+{
+    int c1 = mask_category(hand_mask(hand1)), c2 = mask_category(hand_mask(hand2));
+
+    return c1 != c2 ? sign(c2 - c1) : mask_compare(hand1, hand2);
+}
+
+static comparison_path paths[] = {
+    { "compare_hands", 5, legacy_compare },
+    { "mask_strength", 7, mask_compare },
+    { "wild_strength", 7, wild_compare },
+    { "lookup_strength", 7, lookup_compare },
+    { "mask_category", 7, category_compare },
+};
+
+#define PATHS_N (sizeof(paths) / sizeof(paths[0]))
+
+static long checked;
+
+static void print_hand(Hand *hand)
+{
+    char buffer[30];
+    int i;
+    for (i = 0; i < hand->len; i++) {
+	pretty_format_card(buffer, hand->cards[i]);
+	printf("%s%s", i ? ", " : "    ", buffer);
+    }
+    printf("\n");
+}
+
+/* Compares the two hands by every path that can take them, and bails
+   out at the first one to disagree with the reference. */
+
+static void check_pair(Hand *hand1, Hand *hand2, char *mode)
+{
+    int i, expected = reference_compare(hand1, hand2), got;
+
+    for (i = 0; i < PATHS_N; i++) {
+	if (hand1->len > paths[i].max_cards || hand2->len > paths[i].max_cards) {
+	    continue;
+	}
+	got = paths[i].compare(hand1, hand2);
+	if (got != expected) {
+	    printf("%s: %s says %d, reference says %d, after %ld checks\n",
+		   mode, paths[i].name, got, expected, checked);
+	    print_hand(hand1);
+	    print_hand(hand2);
+	    exit(1);
+	}
+    }
+    checked++;
+}
+
+static void check_masks(CardMask m1, CardMask m2, char *mode)
+{
+    Hand *hand1 = mask_to_hand(m1);
+    Hand *hand2 = mask_to_hand(m2);
+    check_pair(hand1, hand2, mode);
+    free_hand(hand1);
+    free_hand(hand2);
+}
+
+static CardMask random_cards(int n, CardMask dead)
+{
+    CardMask m = 0, card;
+    while (n) {
+	card = CARD_BIT(rand() % 52);
+	if (!(card & (m | dead))) {
+	    m |= card;
+	    n--;
+	}
+    }
+    return m;
+}
+
+static void random_pairs(long n)
+{
+    long i;
+    for (i = 0; i < n; i++) {
+	int len = (i & 1) ? 7 : 5;
+	check_masks(random_cards(len, 0), random_cards(len, 0), "random");
+    }
+}
+
+/* Moves the suits of a mask around, so the result has the same ranks
+   and should tie, unless it happens to make or break a flush. */
+
+static CardMask shuffle_suits(CardMask m)
+{
+    CardMask out = 0;
+    int i, shift = 1 + rand() % 3;
+    for (i = 0; i < 52; i++) {
+	if (m & CARD_BIT(i)) {
+	    out |= CARD_BIT((i + 13 * shift) % 52);
+	}
+    }
+    return out;
+}
+
+/* Pairs that are the same but for one card, or the same ranks in
+   different suits, and a few hands known to have caught out the
+   comparison code before. */
+
+static char *tricky[][2] = {
+    { "A of clubs, 2 of hearts, 3 of clubs, 4 of spades, 5 of clubs",
+      "2 of spades, 3 of hearts, 4 of clubs, 5 of hearts, 6 of clubs" },
+    { "2 of clubs, 2 of spades, 2 of hearts, 2 of diamonds, Q of hearts",
+      "4 of clubs, 4 of spades, 4 of hearts, 4 of diamonds, 3 of hearts" },
+    { "K of clubs, K of spades, 9 of hearts, 4 of diamonds, 3 of hearts",
+      "K of hearts, K of diamonds, 9 of clubs, 4 of clubs, 2 of hearts" },
+    { "7 of clubs, 7 of spades, 7 of hearts, 2 of diamonds, 2 of hearts",
+      "7 of clubs, 7 of spades, 7 of hearts, 3 of diamonds, 3 of hearts" },
+    { "A of hearts, J of hearts, 9 of hearts, 5 of hearts, 3 of hearts",
+      "A of clubs, J of clubs, 9 of clubs, 5 of clubs, 2 of clubs" },
+    { "9 of clubs, 9 of hearts, 4 of spades, 4 of clubs, 2 of clubs, 2 of hearts, 3 of spades",
+      "9 of spades, 9 of diamonds, 4 of hearts, 4 of diamonds, 3 of clubs, 2 of spades, 2 of diamonds" },
+    { "8 of clubs, 8 of hearts, 8 of spades, 5 of clubs, 5 of hearts, 5 of spades, A of diamonds",
+      "8 of diamonds, 8 of hearts, 8 of spades, 6 of clubs, 6 of hearts, K of spades, A of clubs" },
+    { "A of spades, K of spades, Q of spades, J of spades, 9 of spades, 10 of hearts, 2 of clubs",
+      "A of hearts, K of hearts, Q of hearts, J of hearts, 10 of clubs, 9 of hearts, 3 of hearts" },
+};
+
+static void adversarial_pairs(long n)
+{
+    long i;
+    int j;
+    CardMask m, card;
+
+    for (j = 0; j < sizeof(tricky) / sizeof(tricky[0]); j++) {
+	Hand *hand1 = create_batch_hand(tricky[j][0]);
+	Hand *hand2 = create_batch_hand(tricky[j][1]);
+	check_pair(hand1, hand2, "adversarial");
+	check_pair(hand2, hand1, "adversarial");
+	free_hand(hand1);
+	free_hand(hand2);
+    }
+    for (i = 0; i < n; i++) {
+	m = random_cards((i & 1) ? 7 : 5, 0);
+	check_masks(m, shuffle_suits(m), "adversarial");
+	card = random_cards(1, m);
+	check_masks(m, (m & (m - 1)) | card, "adversarial");
+    }
+}
+
+/* Every five-card hand in colex order against the one before it,
+   which usually shares most of its cards. */
+
+static void exhaustive(void)
+{
+    int a, b, c, d, e;
+    CardMask m, last = 0;
+    for (e = 4; e < 52; e++)
+	for (d = 3; d < e; d++)
+	    for (c = 2; c < d; c++)
+		for (b = 1; b < c; b++)
+		    for (a = 0; a < b; a++) {
+			m = CARD_BIT(a) | CARD_BIT(b) | CARD_BIT(c)
+			    | CARD_BIT(d) | CARD_BIT(e);
+			if (last) {
+			    check_masks(m, last, "exhaustive");
+			}
+			last = m;
+		    }
+}
+
+/* The best of m with wilds more cards from from up, none in m, by the
+   reference (NULL if there aren't that many); the caller frees it */
+
+static Hand *best_substitution(CardMask m, int wilds, int from)
+{
+    Hand *best = NULL, *hand;
+    int c;
+
+    if (!wilds) {
+	return mask_to_hand(m);
+    }
+    for (c = from; c < 52; c++) {
+	if (m & CARD_BIT(c)) {
+	    continue;
+	}
+	hand = best_substitution(m | CARD_BIT(c), wilds - 1, c + 1);
+	if (!hand) {
+	    break;    /* no cards left above c for the rest */
+	}
+	if (!best) {
+	    best = hand;
+	}
+	else if (reference_compare(hand, best) > 0) {
+	    free_hand(best);
+	    best = hand;
+	}
+	else {
+	    free_hand(hand);
+	}
+    }
+    return best;
+}
+
+#define DEUCES (CARD_BIT(0) | CARD_BIT(13) | CARD_BIT(26) | CARD_BIT(39))
+
+/* A hand of two to seven cards, one to three of them wild: odd pairs
+   have jokers, even ones deuces. *mp is the cards that aren't wild,
+   and *keyp wild_strength's key. */
+
+static int wild_hand(long i, CardMask *mp, int *keyp)
+{
+    int cards = 2 + rand() % 6, wilds;
+    CardMask m;
+
+    if (i & 1) {
+	wilds = 1 + rand() % (cards < 3 ? cards : 3);
+	m = random_cards(cards - wilds, 0);
+	*keyp = wild_strength(m, wilds, 0);
+    }
+    else {
+	do {
+	    m = random_cards(cards, 0);
+	    wilds = __builtin_popcountll(m & DEUCES);
+	} while (wilds < 1 || wilds > 3);
+	*keyp = wild_strength(m, 0, 1);
+	m &= ~DEUCES;
+    }
+    *mp = m;
+    return wilds;
+}
+
+static void print_wild(CardMask m, int wilds)
+{
+    Hand *hand = mask_to_hand(m);
+    print_hand(hand);
+    printf("    and %d wild\n", wilds);
+    free_hand(hand);
+}
+
+static void wild_pairs(long n)
+{
+    CardMask m1, m2;
+    Hand *best1, *best2;
+    int w1, w2, key1, key2, expected, got;
+    long i;
+
+    for (i = 0; i < n; i++) {
+	w1 = wild_hand(i, &m1, &key1);
+	w2 = wild_hand(i, &m2, &key2);
+	if (STRENGTH_RANKING(key1) == FIVE_OF_A_KIND || STRENGTH_RANKING(key2) == FIVE_OF_A_KIND) {
+	    continue;    /* nothing the reference can make */
+	}
+	best1 = best_substitution(m1, w1, 0);
+	best2 = best_substitution(m2, w2, 0);
+	expected = reference_compare(best1, best2);
+	got = sign(key1 - key2);
+	if (got != expected) {
+	    printf("wild: wild_strength says %d, reference says %d, after %ld checks\n",
+		   got, expected, checked);
+	    print_wild(m1, w1);
+	    print_wild(m2, w2);
+	    exit(1);
+	}
+	free_hand(best1);
+	free_hand(best2);
+	checked++;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    char *mode = argc > 1 ? argv[1] : "random";
+    long n = argc > 2 ? atol(argv[2]) : 100000;
+    srand(argc > 3 ? atoi(argv[3]) : 1);
+
+    if (!strcmp(mode, "random")) {
+	random_pairs(n);
+    }
+    else if (!strcmp(mode, "adversarial")) {
+	adversarial_pairs(n);
+    }
+    else if (!strcmp(mode, "exhaustive")) {
+	exhaustive();
+    }
+    else if (!strcmp(mode, "wild")) {
+	wild_pairs(n);
+    }
+    else {
+	fprintf(stderr, "usage: %s random|adversarial|exhaustive|wild [n] [seed]\n", argv[0]);
+	return 2;
+    }
+    printf("%s: %ld pairs, no mismatches\n", mode, checked);
+    return 0;
+}
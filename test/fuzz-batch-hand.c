@@ -0,0 +1,38 @@
+/* fuzz-batch-hand.c -- libFuzzer entry point for create_batch_hand
+
+  make fuzz                 # with clang and libFuzzer
+  test/fuzz-batch-hand
+
+Whatever the input, parsing mustn't crash or overrun. When it does
+come out as five to seven good, distinct cards, the reference and
+mask evaluators have to agree on the ranking as well.
+
+*/
+
+#include "../cards.h"
+#include <string.h>
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    char *info = malloc(size + 1);
+    Hand *hand;
+    int i, ok;
+
+    memcpy(info, data, size);
+    info[size] = '\0';
+    hand = create_batch_hand(info);
+
+    ok = hand->len >= 5 && hand->len <= 7;
+    for (i = 0; ok && i < hand->len; i++) {
+	ok = card_index(hand->cards[i]) >= 0;
+    }
+    if (ok && __builtin_popcountll(hand_mask(hand)) == hand->len) {
+	if (reference_ranking(hand) != mask_ranking(hand_mask(hand))) {
+	    abort();
+	}
+    }
+
+    free_hand(hand);
+    free(info);
+    return 0;
+}
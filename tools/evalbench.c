@@ -0,0 +1,112 @@
+/* evalbench.c -- memory against speed for the two 7-card evaluators
+
+  tools/evalbench [-n hands] [-t threads]
+
+Times mask_strength (the rank tables only) and lookup_strength with a
+whole LookupTable over n random seven-card hands (a million by
+default), once in random order and once in colex order, where the
+table is read straight through, and prints each one's memory and
+nanoseconds a hand. The table's build time is shown as well, and
+every key from it is checked against mask_strength's.
+
+*/
+
+#include "../cards.h"
+#include <time.h>
+#include <unistd.h>
+
+static volatile long sink;
+
+static double now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static int by_mask(const void *a, const void *b)
+{
+    CardMask m1 = *(const CardMask *)a, m2 = *(const CardMask *)b;
+    int k;
+    long i1 = colex_index(m1, &k), i2 = colex_index(m2, &k);
+    return (i1 > i2) - (i1 < i2);
+}
+
+/* Nanoseconds a hand, the best of three runs */
+
+static double time_hands(LookupTable *tp, CardMask *hands, int n)
+{
+    double start, best = 0;
+    int run, i;
+    long total;
+
+    for (run = 0; run < 3; run++) {
+	start = now();
+	total = 0;
+	if (tp) {
+	    for (i = 0; i < n; i++) {
+		total += lookup_strength(tp, hands[i]);
+	    }
+	}
+	else {
+	    for (i = 0; i < n; i++) {
+		total += mask_strength(hands[i]);
+	    }
+	}
+	sink += total;
+	if (!run || now() - start < best) {
+	    best = now() - start;
+	}
+    }
+    return best * 1e9 / n;
+}
+
+int main(int argc, char *argv[])
+{
+    int c, i, n = 1000000, threads = sysconf(_SC_NPROCESSORS_ONLN), mismatches = 0;
+    CardMask *shuffled, *sorted, m;
+    LookupTable *tp;
+    double start, built;
+
+    while ((c = getopt(argc, argv, "n:t:")) != -1) {
+	switch (c) {
+	case 'n': n = atoi(optarg); break;
+	case 't': threads = atoi(optarg); break;
+	default:
+	    fprintf(stderr, "usage: %s [-n hands] [-t threads]\n", argv[0]);
+	    return 2;
+	}
+    }
+    shuffled = malloc(n * sizeof(CardMask));
+    sorted = malloc(n * sizeof(CardMask));
+    srand(1);
+    for (i = 0; i < n; i++) {
+	for (m = 0; __builtin_popcountll(m) < 7; ) {
+	    m |= CARD_BIT(rand() % 52);
+	}
+	shuffled[i] = sorted[i] = m;
+    }
+    qsort(sorted, n, sizeof(CardMask), by_mask);
+
+    start = now();
+    if (!(tp = make_lookup_table(threads))) {
+	fprintf(stderr, "not enough memory for the table\n");
+	return 1;
+    }
+    built = now() - start;
+    for (i = 0; i < n; i++) {
+	mismatches += lookup_strength(tp, shuffled[i]) != mask_strength(shuffled[i]);
+    }
+    for (i = 1; i < tp->n; i++) {
+	mismatches += tp->keys[i - 1] >= tp->keys[i];
+    }
+
+    printf("%d hands, %d classes, %d mismatches\n\n", n, tp->n, mismatches);
+    printf("evaluator          memory    build   random   colex   (ns a hand)\n");
+    printf("%-16s %8.0fK %7s %8.1f %7.1f\n", "mask_strength", mask_table_bytes() / 1024.0, "-",
+	   time_hands(NULL, shuffled, n), time_hands(NULL, sorted, n));
+    printf("%-16s %8.0fK %6.1fs %8.1f %7.1f\n", "lookup_strength", tp->bytes / 1024.0, built,
+	   time_hands(tp, shuffled, n), time_hands(tp, sorted, n));
+    free_lookup_table(tp);
+    return mismatches != 0;
+}
@@ -0,0 +1,351 @@
+/* evald.c -- a hand evaluation daemon on a Unix domain socket
+
+  tools/evald [socket-path]
+
+One warm process serves every client on the host (see evald.h for the
+requests it takes). Each time round the loop it reads whatever the
+clients have sent, gathers the hands from all the complete requests
+into one batch for mask_strengths, and then writes the replies back in
+order. Equity requests are worked out one at a time, in the loop, so
+they're only taken from the flop on (990 boards at most). A batch takes at
+most JOBS_MAX requests; whatever's left over goes in the next one,
+without waiting on poll, and a client whose buffer is full isn't read
+from until there's room again. Nor is one with OUT_MAX bytes of
+replies it hasn't read yet, until it drains them, so a client that
+only writes can't make the daemon grow without end; if replies can't
+be queued at all, that client is dropped.
+
+Each request's latency is timed from the read that brought in the
+last of it, so requests pipelined together in one read share a start
+but ones that came in separately don't.
+
+On SIGINT or SIGTERM it prints how many requests and batches it has
+seen, and removes the socket.
+
+*/
+
+#include "../cards.h"
+#include "evald.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define CLIENTS_MAX 64
+#define IN_SIZE 65536
+#define JOBS_MAX 4096
+#define BATCH_MAX (CLIENTS_MAX * IN_SIZE / sizeof(CardMask))
+#define STAMPS_MAX (IN_SIZE / sizeof(evald_request))
+#define OUT_MAX (1 << 20)
+
+typedef struct {
+    int fd;
+    unsigned char in[IN_SIZE];
+    size_t in_len;
+    size_t stamped_len;               /* in[] up to here is whole requests */
+    uint64_t stamps[STAMPS_MAX];      /* when each of those arrived */
+    int stamped;
+    unsigned char *out;
+    size_t out_len, out_cap;
+    int broken;                       /* replies couldn't be queued */
+} client;
+
+typedef struct {
+    client *cp;
+    evald_request req;
+    int first;
+    uint64_t arrived;
+} job;
+
+static client *clients[CLIENTS_MAX];
+static job jobs[JOBS_MAX];
+static CardMask batch[BATCH_MAX];
+static int keys[BATCH_MAX];
+static volatile sig_atomic_t stopping;
+static long requests, batches, batched_hands;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void stop(int sig)
+{
+    stopping = 1;
+}
+
+static void drop_client(int i)
+{
+    close(clients[i]->fd);
+    free(clients[i]->out);
+    free(clients[i]);
+    clients[i] = NULL;
+}
+
+/* A client that's taken in no more until it reads some replies */
+
+static int backed_up(client *cp)
+{
+    return cp->out_len >= OUT_MAX;
+}
+
+static void queue_output(client *cp, void *data, size_t len)
+{
+    unsigned char *out;
+
+    if (cp->broken) {
+	return;
+    }
+    if (cp->out_len + len > cp->out_cap) {
+	if (!(out = realloc(cp->out, 2 * (cp->out_len + len)))) {
+	    cp->broken = 1;
+	    return;
+	}
+	cp->out = out;
+	cp->out_cap = 2 * (cp->out_len + len);
+    }
+    memcpy(cp->out + cp->out_len, data, len);
+    cp->out_len += len;
+}
+
+static int valid_request(evald_request *rp, CardMask *masks)
+{
+    switch (rp->op) {
+    case EVALD_EVALUATE:
+	return rp->count > 0;
+    case EVALD_COMPARE:
+	return rp->count > 0 && rp->count % 2 == 0;
+    case EVALD_EQUITY:
+	/* A flop at least, so it's under a thousand boards and doesn't
+	   hold up everyone else's batches */
+	return rp->count == 3
+	    && __builtin_popcountll(masks[0]) == 2 && __builtin_popcountll(masks[1]) == 2
+	    && !(masks[0] & masks[1]) && !((masks[0] | masks[1]) & masks[2])
+	    && __builtin_popcountll(masks[2]) >= 3 && __builtin_popcountll(masks[2]) <= 5;
+    }
+    return 0;
+}
+
+/* Moves the complete requests in a client's buffer onto the job list,
+   and their hands into the batch. Returns the new number of jobs. */
+
+static int take_requests(client *cp, int n, int *batched)
+{
+    size_t used = 0, size;
+    evald_request req;
+    int taken = 0;
+
+    while (n < JOBS_MAX && taken < cp->stamped) {
+	memcpy(&req, cp->in + used, sizeof(req));
+	size = sizeof(req) + req.count * sizeof(CardMask);
+	jobs[n].cp = cp;
+	jobs[n].req = req;
+	jobs[n].first = *batched;
+	jobs[n].arrived = cp->stamps[taken++];
+	memcpy(batch + *batched, cp->in + used + sizeof(req),
+	       req.count * sizeof(CardMask));
+	*batched += req.count;
+	used += size;
+	n++;
+    }
+    memmove(cp->in, cp->in + used, cp->in_len - used);
+    cp->in_len -= used;
+    cp->stamped_len -= used;
+    memmove(cp->stamps, cp->stamps + taken, (cp->stamped - taken) * sizeof(uint64_t));
+    cp->stamped -= taken;
+    return n;
+}
+
+static void reply(job *jp)
+{
+    int32_t results[255];
+    CardMask *masks = batch + jp->first;
+    evald_reply rep = { jp->req.id, jp->req.op, 0, EVALD_OK, 0 };
+    Equity eq;
+    int i;
+
+    if (!valid_request(&jp->req, masks)) {
+	rep.status = EVALD_BAD;
+    }
+    else if (jp->req.op == EVALD_EVALUATE) {
+	for (i = 0; i < jp->req.count; i++) {
+	    results[i] = keys[jp->first + i];
+	}
+	rep.count = jp->req.count;
+    }
+    else if (jp->req.op == EVALD_COMPARE) {
+	for (i = 0; i < jp->req.count; i += 2) {
+	    int k1 = keys[jp->first + i], k2 = keys[jp->first + i + 1];
+	    results[i / 2] = (k1 > k2) - (k1 < k2);
+	}
+	rep.count = jp->req.count / 2;
+    }
+    else {
+	hand_equity(masks[0], masks[1], masks[2], &eq);
+	results[0] = eq.wins;
+	results[1] = eq.ties;
+	results[2] = eq.losses;
+	rep.count = 3;
+    }
+    rep.latency = now_ns() - jp->arrived;
+    queue_output(jp->cp, &rep, sizeof(rep));
+    queue_output(jp->cp, results, rep.count * sizeof(int32_t));
+    requests++;
+}
+
+static int flush_output(client *cp)
+{
+    ssize_t n;
+    while (cp->out_len) {
+	n = write(cp->fd, cp->out, cp->out_len);
+	if (n < 0) {
+	    return errno == EAGAIN ? 0 : -1;
+	}
+	memmove(cp->out, cp->out + n, cp->out_len - n);
+	cp->out_len -= n;
+    }
+    return 0;
+}
+
+/* Reads what there's room for, and stamps each request it completes
+   with the time. Returns -1 at the end of the input or on an error. */
+
+static int read_input(client *cp)
+{
+    evald_request req;
+    uint64_t now;
+    ssize_t n;
+    size_t size;
+
+    if (cp->in_len == IN_SIZE) {
+	return 0;
+    }
+    n = read(cp->fd, cp->in + cp->in_len, IN_SIZE - cp->in_len);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+	return -1;
+    }
+    if (n > 0) {
+	cp->in_len += n;
+	now = now_ns();
+	while (cp->in_len - cp->stamped_len >= sizeof(req)) {
+	    memcpy(&req, cp->in + cp->stamped_len, sizeof(req));
+	    size = sizeof(req) + req.count * sizeof(CardMask);
+	    if (cp->in_len - cp->stamped_len < size) {
+		break;
+	    }
+	    cp->stamps[cp->stamped++] = now;
+	    cp->stamped_len += size;
+	}
+    }
+    return 0;
+}
+
+static int listen_on(char *path)
+{
+    struct sockaddr_un addr = { AF_UNIX };
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    unlink(path);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0
+	|| listen(fd, CLIENTS_MAX) < 0) {
+	perror(path);
+	exit(1);
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    return fd;
+}
+
+static void accept_clients(int listener)
+{
+    int fd, i;
+    while ((fd = accept(listener, NULL, NULL)) >= 0) {
+	for (i = 0; i < CLIENTS_MAX && clients[i]; i++)
+	    ;
+	if (i == CLIENTS_MAX) {
+	    close(fd);
+	    continue;
+	}
+	fcntl(fd, F_SETFL, O_NONBLOCK);
+	clients[i] = calloc(1, sizeof(client));
+	clients[i]->fd = fd;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    char *path = argc > 1 ? argv[1] : EVALD_SOCKET;
+    struct pollfd fds[CLIENTS_MAX + 1];
+    int listener = listen_on(path);
+    int i, n, batched, waiting = 0;
+
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+    signal(SIGPIPE, SIG_IGN);
+
+    while (!stopping) {
+	fds[0].fd = listener;
+	fds[0].events = POLLIN;
+	for (i = 0; i < CLIENTS_MAX; i++) {
+	    fds[i + 1].fd = clients[i] ? clients[i]->fd : -1;
+	    fds[i + 1].events = 0;
+	    if (clients[i] && clients[i]->in_len < IN_SIZE && !backed_up(clients[i])) {
+		fds[i + 1].events |= POLLIN;
+	    }
+	    if (clients[i] && clients[i]->out_len) {
+		fds[i + 1].events |= POLLOUT;
+	    }
+	}
+	/* Don't sleep with requests still to do from last time */
+	if (poll(fds, CLIENTS_MAX + 1, waiting ? 0 : -1) < 0) {
+	    continue;
+	}
+	if (fds[0].revents & POLLIN) {
+	    accept_clients(listener);
+	}
+	for (i = 0; i < CLIENTS_MAX; i++) {
+	    if (clients[i] && fds[i + 1].fd == clients[i]->fd
+		&& (fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR))
+		&& read_input(clients[i]) < 0) {
+		drop_client(i);
+	    }
+	}
+
+	/* Gather everything that's complete into one batch */
+	n = batched = 0;
+	for (i = 0; i < CLIENTS_MAX; i++) {
+	    if (clients[i] && !backed_up(clients[i])) {
+		n = take_requests(clients[i], n, &batched);
+	    }
+	}
+	if (n) {
+	    mask_strengths(batch, keys, batched);
+	    for (i = 0; i < n; i++) {
+		reply(&jobs[i]);
+	    }
+	    batches++;
+	    batched_hands += batched;
+	}
+	for (i = 0, waiting = 0; i < CLIENTS_MAX; i++) {
+	    waiting |= clients[i] && clients[i]->stamped && !backed_up(clients[i]);
+	}
+
+	for (i = 0; i < CLIENTS_MAX; i++) {
+	    if (clients[i] && (clients[i]->broken || flush_output(clients[i]) < 0)) {
+		drop_client(i);
+	    }
+	}
+    }
+
+    printf("%ld requests in %ld batches, %.1f hands per batch\n", requests,
+	   batches, batches ? (double)batched_hands / batches : 0.0);
+    unlink(path);
+    return 0;
+}
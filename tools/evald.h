@@ -0,0 +1,43 @@
+/* evald.h -- the wire format spoken by tools/evald.c
+
+Every request is a fixed header followed by count 64-bit card masks
+(see mask.c); every reply is a header followed by count 32-bit
+results. Both sides are on the same host, so everything goes in host
+byte order. Replies on a connection come back in request order, and
+a client may send as many requests as it likes before reading.
+
+  EVALD_EVALUATE   masks: hands          results: strength keys
+  EVALD_COMPARE    masks: pairs of hands results: 1, 0 or -1 per pair
+  EVALD_EQUITY     masks: hole1, hole2,  results: wins, ties, losses
+                          board          for hole1 over every board
+
+Equity holes are two cards each and the board three to five; anything
+else comes back EVALD_BAD.
+
+*/
+
+#include <stdint.h>
+
+#define EVALD_SOCKET "/tmp/ccards-evald.sock"
+
+#define EVALD_EVALUATE 1
+#define EVALD_COMPARE  2
+#define EVALD_EQUITY   3
+
+#define EVALD_OK  0
+#define EVALD_BAD 1
+
+typedef struct {
+    uint32_t id;
+    uint8_t op;
+    uint8_t count;
+    uint16_t reserved;
+} evald_request;
+
+typedef struct {
+    uint32_t id;
+    uint8_t op;
+    uint8_t count;
+    uint16_t status;
+    uint32_t latency;     /* ns from arrival to reply, at the daemon */
+} evald_reply;
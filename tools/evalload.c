@@ -0,0 +1,165 @@
+/* evalload.c -- load generator for tools/evald
+
+  tools/evalload [-s socket] [-n requests] [-w window] [-b hands] [-o op]
+
+Sends n requests (op is evaluate, compare or equity) of b random
+seven-card hands each, keeping up to w of them in flight on the one
+connection, and checks that the replies come back in order. At the
+end it prints the throughput and the latency percentiles as seen from
+here, alongside the daemon's own figure.
+
+*/
+
+#include "../cards.h"
+#include "evald.h"
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static CardMask random_cards(int n, CardMask dead)
+{
+    CardMask m = 0, card;
+    while (n) {
+	card = CARD_BIT(rand() % 52);
+	if (!(card & (m | dead))) {
+	    m |= card;
+	    n--;
+	}
+    }
+    return m;
+}
+
+static void write_all(int fd, void *data, size_t len)
+{
+    ssize_t n;
+    while (len) {
+	if ((n = write(fd, data, len)) <= 0) {
+	    perror("write");
+	    exit(1);
+	}
+	data = (char *)data + n;
+	len -= n;
+    }
+}
+
+static void read_all(int fd, void *data, size_t len)
+{
+    ssize_t n;
+    while (len) {
+	if ((n = read(fd, data, len)) <= 0) {
+	    fprintf(stderr, "daemon hung up\n");
+	    exit(1);
+	}
+	data = (char *)data + n;
+	len -= n;
+    }
+}
+
+static void send_request(int fd, uint32_t id, int op, int hands)
+{
+    CardMask masks[255];
+    evald_request req = { id, op, 0, 0 };
+    int i;
+
+    if (op == EVALD_EQUITY) {
+	masks[0] = random_cards(2, 0);
+	masks[1] = random_cards(2, masks[0]);
+	masks[2] = random_cards(3, masks[0] | masks[1]);
+	req.count = 3;
+    }
+    else {
+	for (i = 0; i < hands; i++) {
+	    masks[i] = random_cards(7, 0);
+	}
+	req.count = hands;
+    }
+    write_all(fd, &req, sizeof(req));
+    write_all(fd, masks, req.count * sizeof(CardMask));
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(uint64_t *)a, y = *(uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char *argv[])
+{
+    char *path = EVALD_SOCKET, *opname = "evaluate";
+    long requests = 100000, sent = 0, received = 0;
+    int window = 64, hands = 16, op, fd, c;
+    struct sockaddr_un addr = { AF_UNIX };
+    uint64_t start, *sent_at, *latency, daemon_total = 0;
+    int32_t results[255];
+    evald_reply rep;
+
+    while ((c = getopt(argc, argv, "s:n:w:b:o:")) != -1) {
+	switch (c) {
+	case 's': path = optarg; break;
+	case 'n': requests = atol(optarg); break;
+	case 'w': window = atoi(optarg); break;
+	case 'b': hands = atoi(optarg); break;
+	case 'o': opname = optarg; break;
+	default:
+	    fprintf(stderr, "usage: %s [-s socket] [-n requests] [-w window]"
+		    " [-b hands] [-o evaluate|compare|equity]\n", argv[0]);
+	    return 2;
+	}
+    }
+    op = !strcmp(opname, "equity") ? EVALD_EQUITY
+	: !strcmp(opname, "compare") ? EVALD_COMPARE : EVALD_EVALUATE;
+    if (hands < 1 || hands > 254 || window < 1 || requests < 1) {
+	fprintf(stderr, "%s: bad -b, -w or -n\n", argv[0]);
+	return 2;
+    }
+    hands &= (op == EVALD_COMPARE) ? ~1 : ~0;
+
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+	perror(path);
+	return 1;
+    }
+    sent_at = malloc(requests * sizeof(uint64_t));
+    latency = malloc(requests * sizeof(uint64_t));
+
+    start = now_ns();
+    while (received < requests) {
+	while (sent < requests && sent - received < window) {
+	    sent_at[sent] = now_ns();
+	    send_request(fd, sent, op, hands);
+	    sent++;
+	}
+	read_all(fd, &rep, sizeof(rep));
+	read_all(fd, results, rep.count * sizeof(int32_t));
+	if (rep.id != received || rep.status != EVALD_OK) {
+	    fprintf(stderr, "reply %u (status %d) where %ld was expected\n",
+		    rep.id, rep.status, received);
+	    return 1;
+	}
+	latency[received] = now_ns() - sent_at[received];
+	daemon_total += rep.latency;
+	received++;
+    }
+
+    double seconds = (now_ns() - start) / 1e9;
+    qsort(latency, requests, sizeof(uint64_t), compare_u64);
+    printf("%ld %s requests in %.3fs: %.0f requests/s, %.0f hands/s\n",
+	   requests, opname, seconds, requests / seconds,
+	   requests * (op == EVALD_EQUITY ? 1 : hands) / seconds);
+    printf("round trip: p50 %.1fus  p99 %.1fus  max %.1fus;"
+	   " at the daemon: mean %.1fus\n",
+	   latency[requests / 2] / 1e3, latency[requests * 99 / 100] / 1e3,
+	   latency[requests - 1] / 1e3, daemon_total / 1e3 / requests);
+    close(fd);
+    return 0;
+}
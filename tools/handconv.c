@@ -0,0 +1,87 @@
+/* handconv.c -- convert hands between text and the binary format
+
+  tools/handconv [-p] [-s] [-b hands] < hands.txt > hands.bin
+  tools/handconv -t < hands.bin > hands.txt
+
+The text side is one hand a line, in create_batch_hand's form. Going
+to binary, -p stores each hand as packed card bytes (all the hands
+must then have as many cards as the first) rather than as a mask, -s
+stores a strength key alongside, and -b sets the hands per block.
+Lines that don't parse, or don't fit, are skipped and counted on
+stderr. See handfile.c for the format.
+
+*/
+
+#include "../cards.h"
+#include <string.h>
+#include <unistd.h>
+
+static int to_binary(int flags, int block_hands)
+{
+    char line[1024];
+    HandWriter *wp = NULL;
+    CardMask m;
+    long skipped = 0;
+    int n;
+
+    while (fgets(line, sizeof(line), stdin)) {
+	if ((n = text_to_mask(line, &m, NULL)) <= 0) {
+	    skipped++;
+	    continue;
+	}
+	if (!wp && !(wp = create_hand_writer(stdout, n, flags, block_hands))) {
+	    fprintf(stderr, "can't pack hands of %d cards\n", n);
+	    return 1;
+	}
+	if (write_hand(wp, m) < 0) {
+	    skipped++;
+	}
+    }
+    if (!wp) {
+	wp = create_hand_writer(stdout, 0, flags & ~HANDS_PACKED, block_hands);
+    }
+    close_hand_writer(wp);
+    if (skipped) {
+	fprintf(stderr, "skipped %ld lines\n", skipped);
+    }
+    return 0;
+}
+
+static int to_text(void)
+{
+    HandReader *rp = open_hand_reader(stdin);
+    char line[52 * 17 + 2];
+    CardMask m;
+
+    if (!rp) {
+	fprintf(stderr, "not a hand file\n");
+	return 1;
+    }
+    while (read_hand(rp, &m, NULL)) {
+	char *end = mask_to_text(line, m);
+	*end++ = '\n';
+	fwrite(line, 1, end - line, stdout);
+    }
+    close_hand_reader(rp);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    int c, text = 0, flags = 0, block_hands = 0;
+    static char out[1 << 20];
+
+    while ((c = getopt(argc, argv, "tpsb:")) != -1) {
+	switch (c) {
+	case 't': text = 1; break;
+	case 'p': flags |= HANDS_PACKED; break;
+	case 's': flags |= HANDS_STRENGTH; break;
+	case 'b': block_hands = atoi(optarg); break;
+	default:
+	    fprintf(stderr, "usage: %s [-t] [-p] [-s] [-b hands] < in > out\n", argv[0]);
+	    return 2;
+	}
+    }
+    setvbuf(stdout, out, _IOFBF, sizeof(out));
+    return text ? to_text() : to_binary(flags, block_hands);
+}
@@ -0,0 +1,317 @@
+/* history.c -- frequencies and win rates from logs of showdowns
+
+  tools/history [-t threads] [-j] log ...
+  tools/history -g hands [-s seats] [-k key] > log
+
+Reads logs in history.c's form (one hand a line) and prints, as CSV
+or with -j as JSON: how often each ranking was shown down and won,
+each starting hand's wins, splits and average pot share, and how
+often the seat ahead on the flop and on the turn won the pot.
+
+Each log is mapped and cut into one stretch per thread, each starting
+at the first line that begins inside it, and the threads keep their
+own tallies across all the logs, merged once at the end. A log that
+isn't a plain file (zcat day.log.gz | tools/history /dev/stdin, say)
+can't be mapped, so it's read CHUNK bytes at a time and each chunk is
+cut up the same way. Rejected lines are counted on stderr with the
+time taken.
+
+-g writes a log of random hands instead (seats 6 by default, from
+philox as simulate_table deals them), to try it out on.
+
+*/
+
+#include "../cards.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+extern ranking_datum ranking_data[];
+
+#define CHUNK (16 << 20)
+
+typedef struct {
+    HistoryStats stats;
+    char *start, *end;
+} Job;
+
+static void *analyze(void *arg)
+{
+    Job *jp = arg;
+    char *p = jp->start;
+
+    while (p < jp->end) {
+	log_showdown(&jp->stats, p, &p);
+    }
+    return NULL;
+}
+
+/* Splits size bytes at map between the jobs, on line boundaries, and
+   runs them. A last line with no newline is left out, for the caller
+   to copy and finish. */
+
+static char *run_jobs(Job *jobs, int threads, char *map, size_t size)
+{
+    pthread_t *ids = malloc(threads * sizeof(pthread_t));
+    char *limit = map + size, *p;
+    int i, started;
+
+    while (limit > map && limit[-1] != '\n') {
+	limit--;
+    }
+    for (i = 0; i < threads; i++) {
+	p = map + (limit - map) * i / threads;
+	while (p > map && p < limit && p[-1] != '\n') {
+	    p++;
+	}
+	jobs[i].start = p;
+	if (i) {
+	    jobs[i - 1].end = p;
+	}
+    }
+    jobs[threads - 1].end = limit;
+    for (started = 0; ids && started < threads; started++) {
+	if (pthread_create(&ids[started], NULL, analyze, &jobs[started]) != 0) {
+	    break;
+	}
+    }
+    /* Any stretch that didn't get a thread is done here */
+    for (i = started; i < threads; i++) {
+	analyze(&jobs[i]);
+    }
+    for (i = 0; i < started; i++) {
+	pthread_join(ids[i], NULL);
+    }
+    free(ids);
+    return limit;
+}
+
+/* Finishes a last line with no newline, from p up to end */
+
+static void analyze_tail(Job *jobs, char *p, char *end)
+{
+    char *tail = malloc(end - p + 1);
+
+    memcpy(tail, p, end - p);
+    tail[end - p] = '\0';
+    log_showdown(&jobs[0].stats, tail, &p);
+    free(tail);
+}
+
+/* For what can't be mapped: reads CHUNK bytes at a time, and carries
+   the part line at the end of each over to the next */
+
+static int analyze_stream(char *path, int fd, Job *jobs, int threads, long *bytes)
+{
+    size_t size = CHUNK, len = 0;
+    char *buffer = malloc(size), *p;
+    ssize_t n = 0;
+
+    while (buffer && (n = read(fd, buffer + len, size - len)) != 0) {
+	if (n < 0) {
+	    if (errno == EINTR) {
+		continue;
+	    }
+	    break;
+	}
+	*bytes += n;
+	len += n;
+	p = run_jobs(jobs, threads, buffer, len);
+	if (p == buffer && len == size) {
+	    /* A line longer than the buffer */
+	    if (!(p = realloc(buffer, size *= 2))) {
+		break;
+	    }
+	    buffer = p;
+	    continue;
+	}
+	memmove(buffer, p, buffer + len - p);
+	len = buffer + len - p;
+    }
+    if (!buffer || n != 0) {
+	perror(path);
+	free(buffer);
+	close(fd);
+	return -1;
+    }
+    if (len) {
+	analyze_tail(jobs, buffer, buffer + len);
+    }
+    free(buffer);
+    close(fd);
+    return 0;
+}
+
+static int analyze_file(char *path, Job *jobs, int threads, long *bytes)
+{
+    struct stat st;
+    char *map, *p;
+    int fd;
+
+    if ((fd = open(path, O_RDONLY)) < 0) {
+	perror(path);
+	return -1;
+    }
+    if (fstat(fd, &st) < 0) {
+	perror(path);
+	close(fd);
+	return -1;
+    }
+    if (!S_ISREG(st.st_mode)) {
+	return analyze_stream(path, fd, jobs, threads, bytes);
+    }
+    *bytes += st.st_size;
+    if (st.st_size == 0) {
+	close(fd);
+	return 0;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+	perror(path);
+	return -1;
+    }
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+    p = run_jobs(jobs, threads, map, st.st_size);
+    if (p < map + st.st_size) {
+	analyze_tail(jobs, p, map + st.st_size);
+    }
+    munmap(map, st.st_size);
+    return 0;
+}
+
+static void print_csv(HistoryStats *sp)
+{
+    char name[4];
+    int i;
+
+    printf("group,name,shown,won,split,pot_share\n");
+    for (i = 0; i < RANKINGS_N; i++) {
+	printf("ranking,%s,%ld,%ld,,\n", ranking_data[i].ranking, sp->shown[i], sp->won[i]);
+    }
+    for (i = 0; i < STARTING_HANDS; i++) {
+	if (sp->dealt[i]) {
+	    printf("hand,%s,%ld,%ld,%ld,%.6f\n", starting_hand_name(name, i), sp->dealt[i],
+		   sp->wins[i], sp->ties[i], (double)sp->shares[i] / SHARE_UNIT / sp->dealt[i]);
+	}
+    }
+    printf("leader,flop,%ld,%ld,,\n", sp->leads[0], sp->held[0]);
+    printf("leader,turn,%ld,%ld,,\n", sp->leads[1], sp->held[1]);
+}
+
+static void print_json(HistoryStats *sp)
+{
+    char name[4];
+    int i, first = 1;
+
+    printf("{\n  \"hands\": %ld,\n  \"rejected\": %ld,\n", sp->hands, sp->rejected);
+    printf("  \"rankings\": [\n");
+    for (i = 0; i < RANKINGS_N; i++) {
+	printf("    { \"name\": \"%s\", \"shown\": %ld, \"won\": %ld }%s\n",
+	       ranking_data[i].ranking, sp->shown[i], sp->won[i], i < RANKINGS_N - 1 ? "," : "");
+    }
+    printf("  ],\n  \"starting_hands\": [");
+    for (i = 0; i < STARTING_HANDS; i++) {
+	if (sp->dealt[i]) {
+	    printf("%s\n    { \"hand\": \"%s\", \"shown\": %ld, \"won\": %ld, \"split\": %ld, \"pot_share\": %.6f }",
+		   first ? "" : ",", starting_hand_name(name, i), sp->dealt[i], sp->wins[i],
+		   sp->ties[i], (double)sp->shares[i] / SHARE_UNIT / sp->dealt[i]);
+	    first = 0;
+	}
+    }
+    printf("\n  ],\n  \"leaders\": {\n");
+    printf("    \"flop\": { \"hands\": %ld, \"held\": %ld },\n", sp->leads[0], sp->held[0]);
+    printf("    \"turn\": { \"hands\": %ld, \"held\": %ld }\n  }\n}\n", sp->leads[1], sp->held[1]);
+}
+
+static void generate(long hands, int seats, uint64_t key)
+{
+    unsigned char deck[52], card;
+    uint32_t words[28];
+    char text[17 * 3 + 2];
+    long hand;
+    int need = 2 * seats + 5, i, j;
+
+    for (hand = 0; hand < hands; hand++) {
+	for (i = 0; i < need; i += 4) {
+	    philox(hand, i / 4, key, words + i);
+	}
+	for (i = 0; i < 52; i++) {
+	    deck[i] = i;
+	}
+	for (i = 0; i < need; i++) {
+	    j = i + random_below(words[i], 52 - i);
+	    card = deck[j];
+	    deck[j] = deck[i];
+	    deck[i] = card;
+	}
+	mask_to_text(text, CARD_BIT(deck[0]) | CARD_BIT(deck[1]) | CARD_BIT(deck[2]));
+	fputs(text, stdout);
+	for (i = 3; i < need; i += i < 5 ? 1 : 2) {
+	    mask_to_text(text, CARD_BIT(deck[i]) | (i < 5 ? 0 : CARD_BIT(deck[i + 1])));
+	    printf("; %s", text);
+	}
+	putchar('\n');
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int c, i, threads = sysconf(_SC_NPROCESSORS_ONLN), json = 0, seats = 6, status = 0;
+    long generating = 0, bytes = 0;
+    uint64_t key = 1;
+    struct timespec start, end;
+    double seconds;
+    Job *jobs;
+
+    while ((c = getopt(argc, argv, "t:jg:s:k:")) != -1) {
+	switch (c) {
+	case 't': threads = atoi(optarg); break;
+	case 'j': json = 1; break;
+	case 'g': generating = atol(optarg); break;
+	case 's': seats = atoi(optarg); break;
+	case 'k': key = strtoull(optarg, NULL, 10); break;
+	default:
+	    fprintf(stderr, "usage: %s [-t threads] [-j] log ...\n"
+		    "       %s -g hands [-s seats] [-k key]\n", argv[0], argv[0]);
+	    return 2;
+	}
+    }
+    if (threads < 1 || seats < 2 || seats > SEATS_MAX) {
+	fprintf(stderr, "threads go from 1, and seats from 2 to %d\n", SEATS_MAX);
+	return 2;
+    }
+    if (generating) {
+	generate(generating, seats, key);
+	return 0;
+    }
+
+    jobs = calloc(threads, sizeof(Job));
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = optind; i < argc; i++) {
+	if (analyze_file(argv[i], jobs, threads, &bytes) < 0) {
+	    status = 1;
+	}
+    }
+    for (i = 1; i < threads; i++) {
+	merge_history_stats(&jobs[0].stats, &jobs[i].stats);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    seconds = end.tv_sec - start.tv_sec + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    if (json) {
+	print_json(&jobs[0].stats);
+    }
+    else {
+	print_csv(&jobs[0].stats);
+    }
+    fprintf(stderr, "%ld hands (%ld rejected), %.1f MB in %.2fs: %.0f hands a second\n",
+	    jobs[0].stats.hands, jobs[0].stats.rejected, bytes / 1e6, seconds,
+	    jobs[0].stats.hands / seconds);
+    return status;
+}
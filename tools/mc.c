@@ -0,0 +1,196 @@
+/* mc.c -- shardable, resumable Monte Carlo equity runs
+
+  tools/mc run -a hand -b hand [-d board] [-n samples] [-k key]
+               [--shard k/N] [-o result] [-r]
+  tools/mc merge -o result shard-result ...
+  tools/mc show result ...
+
+run works through its share of n samples (all of them, without
+--shard) and saves the tallies to the result file as it goes. With -r
+it picks up from what an earlier, interrupted run left there. merge
+adds shard results back together; the shards can come in any order
+but have to cover one unbroken range between them. Because every
+sample's cards depend only on the key and its own number (see
+montecarlo.c), the merged file is byte for byte what one process
+running the whole range would have written.
+
+*/
+
+#include "../cards.h"
+#include <getopt.h>
+#include <string.h>
+
+#define CHECKPOINT (1 << 20)
+
+static void show(char *name, McResult *rp)
+{
+    printf("%s: samples %llu to %llu, key %llu\n", name,
+	   (unsigned long long)rp->first,
+	   (unsigned long long)(rp->first + rp->count),
+	   (unsigned long long)rp->key);
+    printf("  %llu wins, %llu ties, %llu losses: equity %.6f +/- %.6f\n",
+	   (unsigned long long)rp->wins, (unsigned long long)rp->ties,
+	   (unsigned long long)rp->losses, mc_equity(rp), mc_error(rp));
+}
+
+static int save(char *path, McResult *rp)
+{
+    char temp[4096];
+    FILE *fp;
+    snprintf(temp, sizeof(temp), "%s.tmp", path);
+    if (!(fp = fopen(temp, "wb")) || write_mc_result(fp, rp) < 0
+	|| fclose(fp) || rename(temp, path)) {
+	perror(path);
+	return -1;
+    }
+    return 0;
+}
+
+static int load(char *path, McResult *rp)
+{
+    FILE *fp = fopen(path, "rb");
+    int r = fp ? read_mc_result(fp, rp) : -1;
+    if (fp) {
+	fclose(fp);
+    }
+    return r;
+}
+
+static int parse_hand(char *text, CardMask *mp)
+{
+    if (text_to_mask(text, mp, NULL) < 0) {
+	fprintf(stderr, "can't read \"%s\"\n", text);
+	return -1;
+    }
+    return 0;
+}
+
+static int run(int argc, char *argv[])
+{
+    static struct option options[] = {
+	{ "shard", required_argument, NULL, 's' },
+	{ NULL, 0, NULL, 0 }
+    };
+    char *shard = "0/1", *out = NULL;
+    CardMask hole1 = 0, hole2 = 0, board = 0;
+    uint64_t total = 1000000, key = 1, first, count, step;
+    McResult r, old;
+    int c, resume = 0;
+
+    while ((c = getopt_long(argc, argv, "a:b:d:n:k:s:o:r", options, NULL)) != -1) {
+	switch (c) {
+	case 'a': if (parse_hand(optarg, &hole1) < 0) return 2; break;
+	case 'b': if (parse_hand(optarg, &hole2) < 0) return 2; break;
+	case 'd': if (parse_hand(optarg, &board) < 0) return 2; break;
+	case 'n': total = strtoull(optarg, NULL, 10); break;
+	case 'k': key = strtoull(optarg, NULL, 10); break;
+	case 's': shard = optarg; break;
+	case 'o': out = optarg; break;
+	case 'r': resume = 1; break;
+	default: return 2;
+	}
+    }
+    if (!hole1 || !hole2 || (hole1 & hole2) || ((hole1 | hole2) & board)
+	|| __builtin_popcountll(board) > 5) {
+	fprintf(stderr, "run needs two hands (-a, -b) and a board (-d) with no card twice\n");
+	return 2;
+    }
+    if (parse_shard(shard, total, &first, &count) < 0) {
+	fprintf(stderr, "bad shard \"%s\"\n", shard);
+	return 2;
+    }
+
+    init_mc_result(&r, hole1, hole2, board, key, first);
+    if (resume && out && load(out, &old) == 0) {
+	if (old.hole1 != hole1 || old.hole2 != hole2 || old.board != board
+	    || old.key != key || old.first != first || old.count > count) {
+	    fprintf(stderr, "%s is from a different run\n", out);
+	    return 1;
+	}
+	r = old;
+    }
+    while (r.count < count) {
+	step = count - r.count < CHECKPOINT ? count - r.count : CHECKPOINT;
+	monte_carlo(&r, step);
+	if (out && save(out, &r) < 0) {
+	    return 1;
+	}
+    }
+    if (out && !r.count && save(out, &r) < 0) {
+	return 1;
+    }
+    show(out ? out : "result", &r);
+    return 0;
+}
+
+static int by_first(const void *a, const void *b)
+{
+    const McResult *r1 = a, *r2 = b;
+    return (r1->first > r2->first) - (r1->first < r2->first);
+}
+
+static int merge(int argc, char *argv[])
+{
+    char *out = NULL;
+    McResult *results;
+    int c, i, n;
+
+    while ((c = getopt(argc, argv, "o:")) != -1) {
+	if (c != 'o') {
+	    return 2;
+	}
+	out = optarg;
+    }
+    n = argc - optind;
+    if (!out || n < 1) {
+	fprintf(stderr, "merge needs -o and at least one result\n");
+	return 2;
+    }
+    results = malloc(n * sizeof(McResult));
+    for (i = 0; i < n; i++) {
+	if (load(argv[optind + i], &results[i]) < 0) {
+	    fprintf(stderr, "can't read %s\n", argv[optind + i]);
+	    return 1;
+	}
+    }
+    qsort(results, n, sizeof(McResult), by_first);
+    for (i = 1; i < n; i++) {
+	if (merge_mc_result(&results[0], &results[i]) < 0) {
+	    fprintf(stderr, "the result starting at sample %llu doesn't fit"
+		    " (a different run, or a gap or overlap)\n",
+		    (unsigned long long)results[i].first);
+	    return 1;
+	}
+    }
+    if (save(out, &results[0]) < 0) {
+	return 1;
+    }
+    show(out, &results[0]);
+    free(results);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    McResult r;
+    int i;
+
+    if (argc > 1 && !strcmp(argv[1], "run")) {
+	return run(argc - 1, argv + 1);
+    }
+    if (argc > 1 && !strcmp(argv[1], "merge")) {
+	return merge(argc - 1, argv + 1);
+    }
+    if (argc > 1 && !strcmp(argv[1], "show")) {
+	for (i = 2; i < argc; i++) {
+	    if (load(argv[i], &r) < 0) {
+		fprintf(stderr, "can't read %s\n", argv[i]);
+		return 1;
+	    }
+	    show(argv[i], &r);
+	}
+	return 0;
+    }
+    fprintf(stderr, "usage: %s run|merge|show ...\n", argv[0]);
+    return 2;
+}
@@ -0,0 +1,81 @@
+/* mcbench.c -- how many runouts each sampling mode needs
+
+  tools/mcbench [-e error] [-t trials]
+
+For a few spots, from preflop to the turn, finds the smallest number
+of runouts (going up by a quarter at a time from 32) at which each mode of estimate_equity
+gets within the error (0.005 by default) of the exact equity, as the
+root mean square over a number of trials (200) with different keys.
+It prints that, the runouts as a share of what plain Monte Carlo
+needed, and how often the 95% confidence intervals held the exact
+answer.
+
+*/
+
+#include "../cards.h"
+#include <math.h>
+#include <unistd.h>
+
+static char *spots[][3] = {
+    { "A of spades, K of spades", "Q of hearts, Q of diamonds", "" },
+    { "A of hearts, 5 of hearts", "K of spades, K of clubs", "K of hearts, 9 of hearts, 2 of clubs" },
+    { "J of clubs, 10 of clubs", "A of diamonds, 8 of spades", "9 of clubs, 8 of hearts, 2 of clubs" },
+    { "A of hearts, 5 of hearts", "K of spades, K of clubs",
+      "K of hearts, 9 of hearts, 2 of clubs, 7 of spades" },
+};
+
+static char *modes[SAMPLE_MODES] = { "plain", "stratified", "antithetic", "quasi" };
+
+int main(int argc, char *argv[])
+{
+    double target = 0.005, exact, squares, covered, plain_n = 0;
+    int c, i, mode, trials = 200;
+    CardMask hole1, hole2, board;
+    Equity e;
+    Estimate est;
+    long n, evaluations;
+
+    while ((c = getopt(argc, argv, "e:t:")) != -1) {
+	switch (c) {
+	case 'e': target = atof(optarg); break;
+	case 't': trials = atoi(optarg); break;
+	default:
+	    fprintf(stderr, "usage: %s [-e error] [-t trials]\n", argv[0]);
+	    return 2;
+	}
+    }
+    for (i = 0; i < sizeof(spots) / sizeof(spots[0]); i++) {
+	text_to_mask(spots[i][0], &hole1, NULL);
+	text_to_mask(spots[i][1], &hole2, NULL);
+	board = 0;
+	if (*spots[i][2]) {
+	    text_to_mask(spots[i][2], &board, NULL);
+	}
+	hand_equity(hole1, hole2, board, &e);
+	exact = equity_share(&e);
+	printf("%s / %s on [%s]: %.4f\n", spots[i][0], spots[i][1], spots[i][2], exact);
+	for (mode = 0; mode < SAMPLE_MODES; mode++) {
+	    for (n = 32; ; n += n / 4) {
+		squares = covered = 0;
+		evaluations = 0;
+		for (c = 0; c < trials; c++) {
+		    estimate_equity(hole1, hole2, board, mode, n, c + 1, &est);
+		    squares += (est.equity - exact) * (est.equity - exact);
+		    covered += est.low <= exact && exact <= est.high;
+		    evaluations += est.evaluations;
+		}
+		if (sqrt(squares / trials) <= target || n > (1 << 24)) {
+		    break;
+		}
+	    }
+	    evaluations /= trials;
+	    if (mode == SAMPLE_PLAIN) {
+		plain_n = evaluations;
+	    }
+	    printf("  %-10s %9ld runouts  %5.2fx plain  error %.4f  %3.0f%% covered\n",
+		   modes[mode], evaluations, evaluations / plain_n,
+		   sqrt(squares / trials), 100 * covered / trials);
+	}
+    }
+    return 0;
+}
@@ -0,0 +1,389 @@
+/* perfcount.c -- hardware counters for each evaluation stage
+
+  tools/perfcount [-n hands] [-s stage]
+
+Runs each stage (the legacy Hand paths, the mask evaluators and the
+table-driven solvers) over a corpus of random hands, once in random
+order and once sorted by strength, and reports per operation:
+
+  ns        wall-clock time
+  cycles    CPU cycles, and instructions with the IPC
+  br-miss   mispredicted branches
+  L1d, LLC  level 1 data and last level cache read misses
+
+from perf_event_open, counting this process in user space only. Any
+counter the machine or kernel won't give (in a VM, say, or with
+kernel.perf_event_paranoid set high) shows as "-", and the wall-clock
+times are there regardless. With -s only stages whose names contain
+the string are run.
+
+Sorting by strength puts hands of one ranking together, so the gap
+between the two corpora is mostly what branch prediction buys; a gap
+in L1d or LLC misses instead points at table sizes.
+
+*/
+
+#include "../cards.h"
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CACHE_READ_MISS(cache) \
+    ((cache) | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+
+typedef struct {
+    char *name;
+    uint32_t type;
+    uint64_t config;
+    int fd;
+} Counter;
+
+static Counter counters[] = {
+    { "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { "br-miss", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    { "L1d", PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_L1D) },
+    { "LLC", PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_LL) },
+};
+
+#define COUNTERS_N (sizeof(counters) / sizeof(counters[0]))
+
+typedef struct {
+    int n;
+    CardMask *fives, *sevens;
+    Hand **hands;
+    InlineHand *inlines;
+    char **texts;
+} Corpus;
+
+typedef struct {
+    char *name;
+    int divisor;              /* run on n / divisor hands: for slow stages */
+    void (*run)(Corpus *cp, int n);
+} Stage;
+
+static volatile long sink;
+
+static void open_counters(void)
+{
+    struct perf_event_attr attr;
+    int i;
+
+    for (i = 0; i < COUNTERS_N; i++) {
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = counters[i].type;
+	attr.config = counters[i].config;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+	counters[i].fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+}
+
+/* Runs a stage with every counter that opened going, and puts each
+   count (scaled up if the kernel had to share the counters out) in
+   counts[], or -1 for one that isn't there */
+
+static double measure(Stage *sp, Corpus *cp, int n, double counts[])
+{
+    struct timespec start, end;
+    uint64_t values[3];
+    int i;
+
+    for (i = 0; i < COUNTERS_N; i++) {
+	if (counters[i].fd >= 0) {
+	    ioctl(counters[i].fd, PERF_EVENT_IOC_RESET, 0);
+	    ioctl(counters[i].fd, PERF_EVENT_IOC_ENABLE, 0);
+	}
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    sp->run(cp, n);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    for (i = 0; i < COUNTERS_N; i++) {
+	counts[i] = -1;
+	if (counters[i].fd >= 0) {
+	    ioctl(counters[i].fd, PERF_EVENT_IOC_DISABLE, 0);
+	    if (read(counters[i].fd, values, sizeof(values)) == sizeof(values) && values[2]) {
+		counts[i] = (double)values[0] * values[1] / values[2];
+	    }
+	}
+    }
+    return (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+}
+
+static void parse_text(Corpus *cp, int n)
+{
+    int i;
+    for (i = 0; i < n; i++) {
+	free_hand(create_batch_hand(cp->texts[i]));
+    }
+}
+
+static void rankings_histogram(Corpus *cp, int n)
+{
+    int i, buckets[13];
+    for (i = 0; i < n; i++) {
+	make_rankings_histogram(cp->hands[i], buckets);
+	sink += buckets[i % 13];
+    }
+}
+
+static void profile(Corpus *cp, int n)
+{
+    int i;
+    for (i = 0; i < n; i++) {
+	hand_profile(cp->hands[i]);
+	sink += cp->hands[i]->profile[0];
+    }
+}
+
+static void high_cards(Corpus *cp, int n)
+{
+    int i;
+    for (i = 0; i < n; i++) {
+	sink += (long)high_card(cp->hands[i]);
+    }
+}
+
+static void hand_strength(Corpus *cp, int n)
+{
+    int i;
+    for (i = 0; i < n; i++) {
+	sink += mask_strength(hand_mask(cp->hands[i]));
+    }
+}
+
+static void inline_strength(Corpus *cp, int n)
+{
+    int i;
+    for (i = 0; i < n; i++) {
+	sink += mask_strength(cp->inlines[i].mask);
+    }
+}
+
+static void legacy_ranking(Corpus *cp, int n)
+{
+    int i;
+    for (i = 0; i < n; i++) {
+	sink += hand_ranking(cp->hands[i]);
+    }
+}
+
+static void legacy_compare(Corpus *cp, int n)
+{
+    int i;
+    for (i = 1; i < n; i++) {
+	sink += compare_hands(cp->hands[i - 1], cp->hands[i]);
+    }
+}
+
+static void reference(Corpus *cp, int n)
+{
+    int i, value[6];
+    for (i = 0; i < n; i++) {
+	reference_value(cp->hands[i], value);
+	sink += value[0];
+    }
+}
+
+static void mask_text(Corpus *cp, int n)
+{
+    CardMask m;
+    int i;
+    for (i = 0; i < n; i++) {
+	sink += text_to_mask(cp->texts[i], &m, NULL);
+    }
+}
+
+static void strength_5(Corpus *cp, int n)
+{
+    int i;
+    for (i = 0; i < n; i++) {
+	sink += mask_strength(cp->fives[i]);
+    }
+}
+
+static void strength_7(Corpus *cp, int n)
+{
+    int i;
+    for (i = 0; i < n; i++) {
+	sink += mask_strength(cp->sevens[i]);
+    }
+}
+
+static void category_7(Corpus *cp, int n)
+{
+    int i;
+    for (i = 0; i < n; i++) {
+	sink += mask_category(cp->sevens[i]);
+    }
+}
+
+static void category_counts(Corpus *cp, int n)
+{
+    long counts[RANKINGS_N] = { 0 };
+    mask_category_counts(cp->sevens, n, counts);
+    sink += counts[7];
+}
+
+static void wild_joker(Corpus *cp, int n)
+{
+    int i;
+    for (i = 0; i < n; i++) {
+	sink += wild_strength(cp->sevens[i] & (cp->sevens[i] - 1), 1, 0);
+    }
+}
+
+static void draw_solver(Corpus *cp, int n)
+{
+    DrawOutcome outcomes[32];
+    int i;
+    for (i = 0; i < n; i++) {
+	draw_outcomes(cp->fives[i], outcomes);
+	sink += outcomes[i % 32].draws;
+    }
+}
+
+static void board_ranking(Corpus *cp, int n)
+{
+    static BoardRanking br;
+    int i;
+    for (i = 0; i < n; i++) {
+	sink += rank_board(cp->fives[i], 0, &br);
+    }
+}
+
+static Stage stages[] = {
+    { "create_batch_hand", 1, parse_text },
+    { "make_rankings_histogram", 1, rankings_histogram },
+    { "hand_profile", 1, profile },
+    { "high_card", 1, high_cards },
+    { "hand_mask+mask_strength", 1, hand_strength },
+    { "InlineHand+mask_strength", 1, inline_strength },
+    { "hand_ranking", 1, legacy_ranking },
+    { "compare_hands", 1, legacy_compare },
+    { "reference_value", 1, reference },
+    { "text_to_mask", 1, mask_text },
+    { "mask_strength/5", 1, strength_5 },
+    { "mask_strength/7", 1, strength_7 },
+    { "mask_category/7", 1, category_7 },
+    { "mask_category_counts/7", 1, category_counts },
+    { "wild_strength/6+joker", 1, wild_joker },
+    { "draw_outcomes", 10, draw_solver },
+    { "rank_board", 100, board_ranking },
+};
+
+static CardMask random_cards(int n)
+{
+    CardMask m = 0;
+    while (__builtin_popcountll(m) < n) {
+	m |= CARD_BIT(rand() % 52);
+    }
+    return m;
+}
+
+static int by_strength(const void *a, const void *b)
+{
+    int k1 = mask_strength(*(const CardMask *)a), k2 = mask_strength(*(const CardMask *)b);
+    return (k1 > k2) - (k1 < k2);
+}
+
+/* n random hands, five and seven cards, as masks, Hands and text; or,
+   sorted, the same ones in order of strength */
+
+static void make_corpus(Corpus *cp, int n, Corpus *from)
+{
+    char text[52 * 17 + 2];
+    int i;
+
+    cp->n = n;
+    cp->fives = malloc(n * sizeof(CardMask));
+    cp->sevens = malloc(n * sizeof(CardMask));
+    cp->hands = malloc(n * sizeof(Hand *));
+    cp->inlines = create_inline_hands(n);
+    cp->texts = malloc(n * sizeof(char *));
+    for (i = 0; i < n; i++) {
+	cp->sevens[i] = from ? from->sevens[i] : random_cards(7);
+	cp->fives[i] = from ? from->fives[i] : random_cards(5);
+    }
+    if (from) {
+	qsort(cp->fives, n, sizeof(CardMask), by_strength);
+	qsort(cp->sevens, n, sizeof(CardMask), by_strength);
+    }
+    for (i = 0; i < n; i++) {
+	cp->hands[i] = mask_to_hand(cp->fives[i]);
+	hand_to_inline(cp->hands[i], &cp->inlines[i]);
+	*mask_to_text(text, cp->fives[i]) = '\0';
+	cp->texts[i] = strdup(text);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    Corpus shuffled, sorted, *corpora[2] = { &shuffled, &sorted };
+    char *only = NULL, *names[2] = { "shuffled", "sorted" };
+    double counts[COUNTERS_N], ns;
+    int c, i, k, n = 20000, available = 0, ops;
+    DrawOutcome warm[32];
+
+    while ((c = getopt(argc, argv, "n:s:")) != -1) {
+	switch (c) {
+	case 'n': n = atoi(optarg); break;
+	case 's': only = optarg; break;
+	default:
+	    fprintf(stderr, "usage: %s [-n hands] [-s stage]\n", argv[0]);
+	    return 2;
+	}
+    }
+    srand(1);
+    make_corpus(&shuffled, n, NULL);
+    make_corpus(&sorted, n, &shuffled);
+    draw_outcomes(shuffled.fives[0], warm);     /* builds its tables */
+
+    open_counters();
+    for (i = 0; i < COUNTERS_N; i++) {
+	available += counters[i].fd >= 0;
+    }
+    if (available < COUNTERS_N) {
+	fprintf(stderr, "%d of %d counters unavailable (perf_event_open: %s)\n",
+		(int)COUNTERS_N - available, (int)COUNTERS_N,
+		available ? "some events unsupported" : strerror(errno));
+    }
+
+    printf("%-24s %-8s %9s %9s %9s %5s %8s %8s %8s\n", "stage", "corpus",
+	   "ns", "cycles", "instrs", "IPC", "br-miss", "L1d", "LLC");
+    for (i = 0; i < sizeof(stages) / sizeof(stages[0]); i++) {
+	if (only && !strstr(stages[i].name, only)) {
+	    continue;
+	}
+	for (k = 0; k < 2; k++) {
+	    ops = n / stages[i].divisor > 1 ? n / stages[i].divisor : 1;
+	    ns = measure(&stages[i], corpora[k], ops, counts);
+	    printf("%-24s %-8s %9.1f", stages[i].name, names[k], ns / ops);
+	    for (c = 0; c < COUNTERS_N; c++) {
+		if (c == 2) {
+		    if (counts[0] > 0 && counts[1] >= 0) {
+			printf(" %5.2f", counts[1] / counts[0]);
+		    }
+		    else {
+			printf(" %5s", "-");
+		    }
+		}
+		if (counts[c] < 0) {
+		    printf(" %*s", c < 2 ? 9 : 8, "-");
+		}
+		else {
+		    printf(" %*.*f", c < 2 ? 9 : 8, c < 2 ? 0 : 2, counts[c] / ops);
+		}
+	    }
+	    printf("\n");
+	}
+    }
+    return 0;
+}
@@ -0,0 +1,191 @@
+/* strengths.c -- build and query the hand strength table
+
+  tools/strengths build [-s streets] [-t threads] [-c seconds] [-r] table
+  tools/strengths lookup table hole board
+
+build works out E[HS] and E[HS^2] for every canonical board of the
+streets given (any of f, t and r; ft by default) and writes them into
+the table (see strength.c), checkpointing every -c seconds (60) so
+that -r can carry on from an interrupted run. On one core the flop
+takes about two minutes, the turn less, and the river about a quarter
+of one, but its table is 700MB.
+
+The boards are split evenly between the threads to start with, but a
+flop costs 25 times a turn and 500 times a river, so a thread that
+runs out steals half of what's left from whichever thread has most.
+
+*/
+
+#include "../cards.h"
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct {
+    pthread_mutex_t lock;
+    long next, end;
+} Queue;
+
+static StrengthTable *table;
+static Queue *queues;
+static int threads;
+static long tasks, first_task[4];
+static volatile long finished;
+
+/* The next board for thread self: its own, or else half of someone
+   else's. -1 when there's none left anywhere. */
+
+static long take(int self)
+{
+    Queue *mine = &queues[self], *victim;
+    long task = -1, most, left, half;
+    int i;
+
+    pthread_mutex_lock(&mine->lock);
+    if (mine->next < mine->end) {
+	task = mine->next++;
+    }
+    pthread_mutex_unlock(&mine->lock);
+    while (task < 0) {
+	victim = NULL;
+	most = 0;
+	for (i = 0; i < threads; i++) {
+	    if ((left = queues[i].end - queues[i].next) > most) {
+		most = left;
+		victim = &queues[i];
+	    }
+	}
+	if (!victim) {
+	    return -1;
+	}
+	pthread_mutex_lock(&victim->lock);
+	if ((left = victim->end - victim->next) > 0) {
+	    half = (left + 1) / 2;
+	    victim->end -= half;
+	    task = victim->end;
+	    pthread_mutex_lock(&mine->lock);
+	    mine->next = task + 1;
+	    mine->end = task + half;
+	    pthread_mutex_unlock(&mine->lock);
+	}
+	pthread_mutex_unlock(&victim->lock);
+    }
+    return task;
+}
+
+static void *work(void *arg)
+{
+    double ehs[COMBOS_N], ehs2[COMBOS_N];
+    int self = (long)arg, street, slot;
+    long task;
+
+    while ((task = take(self)) >= 0) {
+	for (street = 0; task >= first_task[street + 1]; street++)
+	    ;
+	slot = task - first_task[street];
+	if (!strength_slot_done(table, street, slot)) {
+	    street_strengths(strength_table_board(table, street, slot), ehs, ehs2);
+	    store_strengths(table, street, slot, ehs, ehs2);
+	}
+	__sync_fetch_and_add(&finished, 1);
+    }
+    return NULL;
+}
+
+static int build(int argc, char *argv[])
+{
+    char *path, *s, *names = "ftr";
+    int c, i, resume = 0, streets = STRENGTH_FLOP | STRENGTH_TURN, every = 60;
+    pthread_t *ids;
+    time_t last;
+
+    threads = sysconf(_SC_NPROCESSORS_ONLN);
+    while ((c = getopt(argc, argv, "s:t:c:r")) != -1) {
+	switch (c) {
+	case 's':
+	    for (streets = 0, s = optarg; *s; s++) {
+		if (!strchr(names, *s)) {
+		    fprintf(stderr, "streets are f, t and r\n");
+		    return 2;
+		}
+		streets |= 1 << (strchr(names, *s) - names);
+	    }
+	    break;
+	case 't': threads = atoi(optarg); break;
+	case 'c': every = atoi(optarg); break;
+	case 'r': resume = 1; break;
+	default: return 2;
+	}
+    }
+    if (optind != argc - 1 || threads < 1 || !streets) {
+	fprintf(stderr, "build needs one table file, a thread or more and a street\n");
+	return 2;
+    }
+    path = argv[optind];
+    if (!(table = resume ? open_strength_table(path, 1) : NULL)
+	&& !(table = create_strength_table(path, streets))) {
+	perror(path);
+	return 1;
+    }
+
+    for (i = 0; i < 3; i++) {
+	first_task[i + 1] = first_task[i] + strength_table_boards(table, i);
+    }
+    tasks = first_task[3];
+    queues = calloc(threads, sizeof(Queue));
+    ids = calloc(threads, sizeof(pthread_t));
+    for (i = 0; i < threads; i++) {
+	pthread_mutex_init(&queues[i].lock, NULL);
+	queues[i].next = tasks * i / threads;
+	queues[i].end = tasks * (i + 1) / threads;
+	pthread_create(&ids[i], NULL, work, (void *)(long)i);
+    }
+    for (last = time(NULL); finished < tasks; sleep(1)) {
+	if (time(NULL) - last >= every) {
+	    checkpoint_strength_table(table, 0);
+	    fprintf(stderr, "%ld of %ld boards\n", finished, tasks);
+	    last = time(NULL);
+	}
+    }
+    for (i = 0; i < threads; i++) {
+	pthread_join(ids[i], NULL);
+    }
+    if (checkpoint_strength_table(table, 1) < 0) {
+	perror(path);
+	return 1;
+    }
+    close_strength_table(table);
+    return 0;
+}
+
+static int lookup(int argc, char *argv[])
+{
+    CardMask hole, board;
+    double ehs, ehs2;
+
+    if (argc != 4 || !(table = open_strength_table(argv[1], 0))) {
+	fprintf(stderr, "lookup needs a table, a hole and a board\n");
+	return 2;
+    }
+    if (text_to_mask(argv[2], &hole, NULL) < 0 || text_to_mask(argv[3], &board, NULL) < 0
+	|| strength_lookup(table, hole, board, &ehs, &ehs2) < 0) {
+	fprintf(stderr, "no such hand in %s\n", argv[1]);
+	return 1;
+    }
+    printf("E[HS] %.4f  E[HS^2] %.4f\n", ehs, ehs2);
+    close_strength_table(table);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1 && !strcmp(argv[1], "build")) {
+	return build(argc - 1, argv + 1);
+    }
+    if (argc > 1 && !strcmp(argv[1], "lookup")) {
+	return lookup(argc - 1, argv + 1);
+    }
+    fprintf(stderr, "usage: %s build|lookup ...\n", argv[0]);
+    return 2;
+}
@@ -0,0 +1,102 @@
+/* table.c -- how each starting hand does at a full table
+
+  tools/table [-s seats] [-n hands] [-k key] [-t threads]
+
+Deals n whole hands (a million by default) to a table of 2 to 10
+seats (6), all of them going to showdown, and prints each of the 169
+starting hands with how often it won outright, split, and its average
+share of the pot, best first. The threads each deal their own stretch
+of hand numbers, so the figures for a key don't depend on how many
+there were.
+
+*/
+
+#include "../cards.h"
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct {
+    TableStats stats;
+    uint64_t count;
+} Job;
+
+static void *deal(void *arg)
+{
+    Job *jp = arg;
+    simulate_table(&jp->stats, jp->count);
+    return NULL;
+}
+
+static TableStats *sorting;
+
+static int by_share(const void *a, const void *b)
+{
+    int h1 = *(const int *)a, h2 = *(const int *)b;
+    double s1 = sorting->dealt[h1] ? (double)sorting->shares[h1] / sorting->dealt[h1] : 0;
+    double s2 = sorting->dealt[h2] ? (double)sorting->shares[h2] / sorting->dealt[h2] : 0;
+    return (s1 < s2) - (s1 > s2);
+}
+
+int main(int argc, char *argv[])
+{
+    int c, i, seats = 6, threads = sysconf(_SC_NPROCESSORS_ONLN), order[STARTING_HANDS];
+    uint64_t hands = 1000000, key = 1;
+    struct timespec start, end;
+    pthread_t *ids;
+    Job *jobs;
+    char name[4];
+    double seconds, dealt;
+
+    while ((c = getopt(argc, argv, "s:n:k:t:")) != -1) {
+	switch (c) {
+	case 's': seats = atoi(optarg); break;
+	case 'n': hands = strtoull(optarg, NULL, 10); break;
+	case 'k': key = strtoull(optarg, NULL, 10); break;
+	case 't': threads = atoi(optarg); break;
+	default:
+	    fprintf(stderr, "usage: %s [-s seats] [-n hands] [-k key] [-t threads]\n", argv[0]);
+	    return 2;
+	}
+    }
+    if (seats < 2 || seats > SEATS_MAX || threads < 1) {
+	fprintf(stderr, "seats go from 2 to %d, and threads from 1\n", SEATS_MAX);
+	return 2;
+    }
+
+    jobs = malloc(threads * sizeof(Job));
+    ids = malloc(threads * sizeof(pthread_t));
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < threads; i++) {
+	init_table_stats(&jobs[i].stats, seats, key, hands * i / threads);
+	jobs[i].count = hands * (i + 1) / threads - hands * i / threads;
+	pthread_create(&ids[i], NULL, deal, &jobs[i]);
+    }
+    for (i = 0; i < threads; i++) {
+	pthread_join(ids[i], NULL);
+	if (i) {
+	    merge_table_stats(&jobs[0].stats, &jobs[i].stats);
+	}
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    seconds = end.tv_sec - start.tv_sec + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    sorting = &jobs[0].stats;
+    for (i = 0; i < STARTING_HANDS; i++) {
+	order[i] = i;
+    }
+    qsort(order, STARTING_HANDS, sizeof(int), by_share);
+    printf("%d seats, %llu hands in %.2fs (%.0f a second)\n\n", seats,
+	   (unsigned long long)hands, seconds, hands / seconds);
+    printf("hand     dealt    won   split   pot share\n");
+    for (i = 0; i < STARTING_HANDS; i++) {
+	int h = order[i];
+	if (!(dealt = sorting->dealt[h])) {
+	    continue;
+	}
+	printf("%-4s %9.0f %6.2f%% %6.2f%%   %6.2f%%\n", starting_hand_name(name, h), dealt,
+	       100 * sorting->wins[h] / dealt, 100 * sorting->ties[h] / dealt,
+	       100.0 * sorting->shares[h] / SHARE_UNIT / dealt);
+    }
+    return 0;
+}